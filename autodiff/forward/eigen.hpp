@@ -28,6 +28,14 @@
 // SOFTWARE.
 
 #pragma once
+
+// C++ includes
+#include <algorithm>
+#include <vector>
+
+// Eigen includes
+#include <Eigen/Core>
+
 #include "forward.hpp"
 
 //------------------------------------------------------------------------------
@@ -70,6 +78,92 @@ struct ScalarBinaryOpTraits<autodiff::forward::ValueType<T>, autodiff::forward::
 
 } // namespace Eigen
 
+//------------------------------------------------------------------------------
+// VECTOR-MODE GRADIENTS (N TANGENT DIRECTIONS PER EVALUATION)
+//------------------------------------------------------------------------------
+namespace autodiff::forward {
+
+/// Fixed-size array of N directional derivatives, used as the grad type of a Dual.
+/// A Dual<T, GradVector<T, N>> carries N tangent directions through a single
+/// evaluation, so the derivative updates in the operators become short
+/// coefficient-wise loops over the array that the compiler can vectorize.
+template<typename T, int N>
+struct GradVector : Eigen::Array<T, N, 1>
+{
+    using Base = Eigen::Array<T, N, 1>;
+
+    GradVector() : Base(Base::Zero()) {}
+
+    /// Broadcast a number to all directions (e.g. `grad(0)` or `grad = 1.0`)
+    template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+    GradVector(U s) : Base(Base::Constant(static_cast<T>(s))) {}
+
+    template<typename Derived>
+    GradVector(const Eigen::ArrayBase<Derived>& other) : Base(other) {}
+
+    template<typename Derived>
+    GradVector& operator=(const Eigen::ArrayBase<Derived>& other)
+    {
+        Base::operator=(other);
+        return *this;
+    }
+
+    template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+    GradVector& operator=(U s)
+    {
+        this->setConstant(static_cast<T>(s));
+        return *this;
+    }
+};
+
+namespace traits {
+
+template<typename T, int N>
+struct GradType<GradVector<T, N>> { using type = GradVector<T, N>; };
+
+} // namespace traits
+
+/// Dual number carrying N tangent directions in vector mode
+template<int N, typename T = double>
+using VectorDual = Dual<T, GradVector<T, N>>;
+
+/// Second-order dual whose inner grad carries N tangent directions, for Hessian rows
+template<int N, typename T = double>
+using VectorDual2nd = Dual<VectorDual<N, T>, VectorDual<N, T>>;
+
+using dual4 = VectorDual<4>;
+using dual8 = VectorDual<8>;
+using dual2nd4 = VectorDual2nd<4>;
+using dual2nd8 = VectorDual2nd<8>;
+
+namespace detail {
+
+/// Number of tangent directions carried by a grad type
+template<typename G>
+struct GradWidth { static constexpr Eigen::Index value = 1; };
+
+template<typename T, int N>
+struct GradWidth<GradVector<T, N>> { static constexpr Eigen::Index value = N; };
+
+/// Set direction *k* of *grad* to *value*
+template<typename G, typename U>
+void seedDirection(G& grad, Eigen::Index k, U value)
+{
+    if constexpr (GradWidth<G>::value == 1) grad = value;
+    else grad[k] = value;
+}
+
+/// Return direction *k* of *grad*
+template<typename G>
+auto direction(const G& grad, Eigen::Index k)
+{
+    if constexpr (GradWidth<G>::value == 1) return grad;
+    else return grad[k];
+}
+
+} // namespace detail
+} // namespace autodiff::forward
+
 
 //------------------------------------------------------------------------------
 // TYPEDEFS FOR EIGEN MATRICES, ARRAYS AND VECTORS OF DUAL
@@ -99,6 +193,10 @@ EIGEN_MAKE_FIXED_TYPEDEFS(Type, TypeSuffix, 4)
 
 EIGEN_MAKE_TYPEDEFS_ALL_SIZES(autodiff::dual, dual)
 EIGEN_MAKE_TYPEDEFS_ALL_SIZES(autodiff::HigherOrderDual<2>, dual2nd)
+EIGEN_MAKE_TYPEDEFS_ALL_SIZES(autodiff::forward::dual4, dual4)
+EIGEN_MAKE_TYPEDEFS_ALL_SIZES(autodiff::forward::dual8, dual8)
+EIGEN_MAKE_TYPEDEFS_ALL_SIZES(autodiff::forward::dual2nd4, dual2nd4)
+EIGEN_MAKE_TYPEDEFS_ALL_SIZES(autodiff::forward::dual2nd8, dual2nd8)
 
 #undef EIGEN_MAKE_TYPEDEFS_ALL_SIZES
 #undef EIGEN_MAKE_TYPEDEFS
@@ -198,26 +296,65 @@ constexpr auto wrtpack(Args&&... args)
     return (comatible_tuple(std::forward<typename detail::makeTypeCompatible<Args>::type>(args)...));
 }
 
+namespace detail {
+/// Grad type of the variables in *wrt* (taken from its first entry)
+template<typename Wrt>
+using WrtGradType = decltype(std::declval<std::decay_t<decltype(std::get<0>(std::declval<Wrt&>())[0])>&>().grad);
+
+/// Set the seeds of the variables with joined index in [begin, begin + width) to *value*,
+/// variable *begin + k* being seeded in direction *k*
+template<typename Wrt, typename U>
+void seedChunk(Wrt&& wrt, Eigen::Index begin, Eigen::Index width, U value)
+{
+    Eigen::Index current_index_pos = 0;
+    forEach(wrt, [&](auto&& w) {
+        const Eigen::Index first = std::max<Eigen::Index>(begin, current_index_pos);
+        const Eigen::Index last = std::min<Eigen::Index>(begin + width, current_index_pos + w.size());
+        for(auto j = first; j < last; ++j)
+            seedDirection(w[j - current_index_pos].grad, j - begin, value);
+        current_index_pos += w.size();
+    });
+}
+
+/// Return pointers to the variables in *wrt*, in joined index order
+template<typename Wrt>
+auto flatten(Wrt&& wrt)
+{
+    using Item = std::decay_t<decltype(std::get<0>(wrt)[0])>;
+    std::vector<Item*> items;
+    items.reserve(count(wrt));
+    forEach(wrt, [&](auto&& w) {
+        for(auto j = 0; j < w.size(); ++j)
+            items.push_back(&w[j]);
+    });
+    return items;
+}
+} // namespace detail
+
 /// Return the gradient vector of scalar function *f* with respect to some or all variables *x*.
+/// When the variables are vector-mode duals (e.g. VectorXdual8), each evaluation of *f*
+/// computes a chunk of N gradient entries at once.
 template<typename Function, typename Wrt, typename Args, typename Result>
 auto gradient(const Function& f, Wrt&& wrt, Args&& args, Result& u) -> Eigen::VectorXd
 {
-    std::size_t n = detail::count(wrt);
+    const Eigen::Index n = detail::count(wrt);
 
     Eigen::VectorXd g(n);
 
-    Eigen::Index current_index_pos = 0;
-    detail::forEach(wrt, [&](auto&& w) {
-        for(auto j = 0; j < w.size(); ++j)
-        {
-            w[j].grad = 1.0;
-            u = std::apply(f, args);
-            w[j].grad = 0.0;
-            g[j + current_index_pos] = u.grad;
-        }
+    if(n == 0) return g;
 
-        current_index_pos += w.size();
-    });
+    constexpr auto N = detail::GradWidth<detail::WrtGradType<Wrt>>::value;
+
+    for(Eigen::Index c = 0; c < n; c += N)
+    {
+        const auto width = std::min<Eigen::Index>(N, n - c);
+        detail::seedChunk(wrt, c, width, 1.0);
+        u = std::apply(f, args);
+        detail::seedChunk(wrt, c, width, 0.0);
+
+        for(auto k = 0; k < width; ++k)
+            g[c + k] = detail::direction(u.grad, k);
+    }
 
     return g;
 }
@@ -232,51 +369,33 @@ auto gradient(const Function& f, Wrt&& wrt, Args&& args) -> Eigen::VectorXd
 }
 
 /// Return the Jacobian matrix of a function *f* with respect to some or all variables.
+/// When the variables are vector-mode duals (e.g. VectorXdual8), each evaluation of *f*
+/// computes a chunk of N Jacobian columns at once.
 template<typename Function, typename Wrt, typename Args, typename Result>
 auto jacobian(const Function& f, Wrt&& wrt, Args&& args, Result& F) -> Eigen::MatrixXd
 {
-    std::size_t n = detail::count(wrt);
+    const Eigen::Index n = detail::count(wrt);
 
     if(n == 0) return {};
 
-    std::get<0>(wrt)[0].grad = 1.0;
-    F = std::apply(f, args);
-    std::get<0>(wrt)[0].grad = 0.0;
-
-    const auto m = F.size();
+    constexpr auto N = detail::GradWidth<detail::WrtGradType<Wrt>>::value;
 
-    Eigen::MatrixXd J(m, n);
+    Eigen::MatrixXd J;
 
-    for(auto i = 0; i < m; ++i)
-        J(i, 0) = F[i].grad;
-
-    Eigen::Index current_index_pos = std::get<0>(wrt).size();
-    constexpr auto wrt_count = std::tuple_size_v<std::remove_reference_t<Wrt>>;
-    detail::forEach(detail::tailView<wrt_count - 1>(wrt), [&] (auto&& w) {
-        w[0].grad = 1.0;
+    for(Eigen::Index c = 0; c < n; c += N)
+    {
+        const auto width = std::min<Eigen::Index>(N, n - c);
+        detail::seedChunk(wrt, c, width, 1.0);
         F = std::apply(f, args);
-        w[0].grad = 0.0;
+        detail::seedChunk(wrt, c, width, 0.0);
 
-        for(auto i = 0; i < m; ++i)
-            J(i, current_index_pos) = F[i].grad;
+        if(c == 0)
+            J.resize(F.size(), n);
 
-        current_index_pos += w.size();
-    });
-
-    current_index_pos = 0;
-    detail::forEach(wrt, [&] (auto&& w) {
-        for(auto j = 1; j < w.size(); ++j)
-        {
-            w[j].grad = 1.0;
-            F = std::apply(f, args);
-            w[j].grad = 0.0;
-
-            for(auto i = 0; i < m; ++i)
-                J(i, j + current_index_pos) = F[i].grad;
-        }
-
-        current_index_pos += w.size();
-    });
+        for(auto k = 0; k < width; ++k)
+            for(auto i = 0; i < F.size(); ++i)
+                J(i, c + k) = detail::direction(F[i].grad, k);
+    }
 
     return J;
 }
@@ -290,41 +409,56 @@ auto jacobian(const Function& f, Wrt&& wrt, Args&& args) -> Eigen::MatrixXd
     return jacobian(f, std::forward<Wrt>(wrt), std::forward<Args>(args), F);
 }
 
+namespace detail {
+/// Evaluate row *i* of the Hessian at the columns *cols* (all j >= i for a dense Hessian)
+/// and entry *i* of the gradient. The outer grad of variable *i* is seeded once, and the
+/// inner grads of the columns are seeded N at a time for vector-mode inner duals.
+template<typename Function, typename Item, typename Args, typename Result, typename Gradient>
+void hessianRow(const Function& f, const std::vector<Item*>& items, Args&& args, Result& u,
+    Eigen::MatrixXd& H, Gradient& g, Eigen::Index i, const std::vector<Eigen::Index>& cols)
+{
+    constexpr Eigen::Index N = GradWidth<decltype(Item::val.grad)>::value;
+    const Eigen::Index m = cols.size();
+
+    items[i]->grad = 1.0;
+    for(Eigen::Index c = 0; c == 0 || c < m; c += N)
+    {
+        const auto width = std::min<Eigen::Index>(N, m - c);
+        for(auto k = 0; k < width; ++k)
+            seedDirection(items[cols[c + k]]->val.grad, k, 1.0);
+        u = std::apply(f, args);
+        for(auto k = 0; k < width; ++k)
+            seedDirection(items[cols[c + k]]->val.grad, k, 0.0);
+
+        for(auto k = 0; k < width; ++k)
+            H(cols[c + k], i) = H(i, cols[c + k]) = direction(u.grad.grad, k);
+    }
+    items[i]->grad = 0.0;
+
+    g[i] = static_cast<double>(u.grad.val);
+}
+} // namespace detail
+
 /// Return the hessian matrix of scalar function *f* with respect to some or all variables *x*.
+/// Only the upper triangle j >= i is evaluated. With vector-mode inner duals (e.g.
+/// VectorXdual2nd8), each evaluation of *f* computes N entries of a row at once.
 template<typename Function, typename Wrt, typename Args, typename Result, typename Gradient>
 auto hessian(const Function& f, Wrt&& wrt, Args&& args, Result& u, Gradient& g) -> Eigen::MatrixXd
 {
-    std::size_t n = detail::count(wrt);
+    const auto items = detail::flatten(wrt);
+    const Eigen::Index n = items.size();
 
     Eigen::MatrixXd H(n, n);
     g.resize(n);
 
-    // TODO: take symmetry into account (for tuple forEach)
-    Eigen::Index current_index_pos_outer = 0;
-    detail::forEach(wrt, [&](auto&& outer) {
-        Eigen::Index current_index_pos_inner = 0;
-        detail::forEach(wrt, [&](auto&& inner) {
-            for (auto i = 0; i < outer.size(); i++)
-            {
-                outer[i].grad = 1.0;
-                for (auto j = i; j < inner.size(); ++j)
-                {
-                    const auto ii = i + current_index_pos_outer;
-                    const auto jj = j + current_index_pos_inner;
-
-                    inner[j].val.grad = 1.0;
-                    u = std::apply(f, args);
-                    inner[j].val.grad = 0.0;
-
-                    H(jj, ii) = H(ii, jj) = u.grad.grad;
-                    g(ii) = static_cast<double>(u.grad);
-                }
-                outer[i].grad = 0.0;
-            }
-            current_index_pos_inner += inner.size();
-        });
-        current_index_pos_outer += outer.size();
-    });
+    std::vector<Eigen::Index> cols;
+    for(Eigen::Index i = 0; i < n; ++i)
+    {
+        cols.clear();
+        for(auto j = i; j < n; ++j)
+            cols.push_back(j);
+        detail::hessianRow(f, items, args, u, H, g, i, cols);
+    }
 
     return H;
 }
@@ -342,4 +476,10 @@ auto hessian(const Function& f, Wrt&& wrt, Args&& args) -> Eigen::MatrixXd
 
 namespace autodiff {
 using forward::wrtpack;
+using forward::VectorDual;
+using forward::dual4;
+using forward::dual8;
+using forward::VectorDual2nd;
+using forward::dual2nd4;
+using forward::dual2nd8;
 }
@@ -0,0 +1,293 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright (c) 2018-2020 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// C++ includes
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// autodiff includes
+#include <autodiff/forward/eigen.hpp>
+
+//------------------------------------------------------------------------------
+// THREAD-PARALLEL GRADIENT, JACOBIAN AND HESSIAN DRIVERS
+//------------------------------------------------------------------------------
+// The drivers below evaluate *f* concurrently. Every worker owns a private
+// copy of *args* with its own seeds, so *f* must only read its arguments and
+// must not touch shared mutable state. The variables in *wrt* must be duals
+// passed directly in *args* or entries of Eigen matrices/vectors in *args*.
+namespace autodiff::forward::parallel {
+
+namespace detail {
+
+using forward::detail::direction;
+using forward::detail::flatten;
+using forward::detail::GradWidth;
+using forward::detail::hessianRow;
+using forward::detail::seedDirection;
+
+template<typename T, typename = void>
+struct PrivateType { using type = std::decay_t<T>; };
+
+template<typename T>
+struct PrivateType<T, std::enable_if_t<std::is_base_of_v<Eigen::EigenBase<std::decay_t<T>>, std::decay_t<T>>>>
+{ using type = typename std::decay_t<T>::PlainObject; };
+
+/// Type of a worker's private copy of an argument (blocks and expressions are evaluated)
+template<typename T>
+using Private = typename PrivateType<T>::type;
+
+/// Return the storage of *arg* holding variables of type *Item*, or an empty range
+template<typename Item, typename Arg>
+auto storage(Arg& arg) -> std::pair<Item*, Eigen::Index>
+{
+    using A = std::remove_const_t<std::remove_reference_t<Arg>>;
+    if constexpr (std::is_same_v<A, Item>)
+        return { const_cast<Item*>(&arg), 1 };
+    else if constexpr (std::is_base_of_v<Eigen::PlainObjectBase<A>, A>) {
+        if constexpr (std::is_same_v<typename A::Scalar, Item>)
+            return { const_cast<Item*>(arg.data()), arg.size() };
+        else return { nullptr, 0 };
+    }
+    else return { nullptr, 0 };
+}
+
+/// Location of a variable: (argument index, offset in the argument's storage)
+using Location = std::pair<std::size_t, Eigen::Index>;
+
+/// Locate every variable in *items* inside *args*
+template<typename Item, typename Args>
+auto locate(const std::vector<Item*>& items, Args&& args) -> std::vector<Location>
+{
+    std::vector<Location> locations(items.size(), Location{ std::size_t(-1), 0 });
+    std::size_t a = 0;
+    forward::detail::forEach(args, [&](auto&& arg) {
+        const auto [begin, size] = storage<Item>(arg);
+        for(std::size_t i = 0; i < items.size() && size > 0; ++i)
+            if(items[i] >= begin && items[i] < begin + size)
+                locations[i] = { a, items[i] - begin };
+        ++a;
+    });
+    for([[maybe_unused]] const auto& l : locations)
+        assert(l.first != std::size_t(-1) && "parallel: a wrt variable is not stored in args");
+    return locations;
+}
+
+/// Return pointers to the variables at *locations* inside *args*
+template<typename Item, typename Args>
+auto resolve(const std::vector<Location>& locations, Args& args) -> std::vector<Item*>
+{
+    std::vector<std::pair<Item*, Eigen::Index>> storages;
+    forward::detail::forEach(args, [&](auto& arg) { storages.push_back(storage<Item>(arg)); });
+    std::vector<Item*> items(locations.size());
+    for(std::size_t i = 0; i < locations.size(); ++i)
+        items[i] = storages[locations[i].first].first + locations[i].second;
+    return items;
+}
+
+/// Return a private copy of the arguments in *args*
+template<typename Args>
+auto copy(const Args& args)
+{
+    return std::apply([](const auto&... arg) {
+        return std::tuple<Private<decltype(arg)>...>(arg...);
+    }, args);
+}
+
+/// Run *task(items, args, tasks)* on *nthreads* workers, each owning a private copy of *args*.
+/// Workers take task indices in [begin, end) from a shared counter.
+template<typename Args, typename Item, typename Task>
+void run(Args&& args, const std::vector<Item*>& items, std::size_t begin, std::size_t end, std::size_t nthreads, const Task& task)
+{
+    if(begin >= end) return;
+    if(nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, end - begin);
+
+    const auto locations = locate(items, args);
+    std::atomic<std::size_t> next(begin);
+
+    std::vector<std::thread> threads;
+    for(std::size_t t = 0; t < nthreads; ++t)
+        threads.emplace_back([&]() {
+            auto mine = copy(args);
+            const auto myitems = resolve<Item>(locations, mine);
+            for(auto i = next++; i < end; i = next++)
+                task(myitems, mine, i);
+        });
+    for(auto& thread : threads)
+        thread.join();
+}
+
+/// Seed variables [c, c + width) of *items* in directions [0, width) with *value*
+template<typename Item, typename U>
+void seedChunk(const std::vector<Item*>& items, Eigen::Index c, Eigen::Index width, U value)
+{
+    for(auto k = 0; k < width; ++k)
+        seedDirection(items[c + k]->grad, k, value);
+}
+
+} // namespace detail
+
+/// Return the gradient vector of scalar function *f* with respect to some or all variables *x*,
+/// evaluating chunks of the gradient on *nthreads* threads (0 for all hardware threads).
+template<typename Function, typename Wrt, typename Args, typename Result>
+auto gradient(const Function& f, Wrt&& wrt, Args&& args, Result& u, std::size_t nthreads = 0) -> Eigen::VectorXd
+{
+    const auto items = detail::flatten(wrt);
+    const Eigen::Index n = items.size();
+
+    Eigen::VectorXd g(n);
+
+    if(n == 0) return g;
+
+    using Item = std::decay_t<decltype(*items[0])>;
+    constexpr auto N = detail::GradWidth<decltype(Item::grad)>::value;
+
+    const auto evaluate = [&](const std::vector<Item*>& vars, auto& myargs, Result& result, Eigen::Index c) {
+        const auto width = std::min<Eigen::Index>(N, n - c);
+        detail::seedChunk(vars, c, width, 1.0);
+        result = std::apply(f, myargs);
+        detail::seedChunk(vars, c, width, 0.0);
+        for(auto k = 0; k < width; ++k)
+            g[c + k] = detail::direction(result.grad, k);
+    };
+
+    evaluate(items, args, u, 0);
+
+    const std::size_t nchunks = (n + N - 1) / N;
+    detail::run(args, items, 1, nchunks, nthreads, [&](const auto& vars, auto& myargs, std::size_t chunk) {
+        Result result;
+        evaluate(vars, myargs, result, chunk * N);
+    });
+
+    return g;
+}
+
+/// Return the gradient vector of scalar function *f* with respect to some or all variables *x*.
+template<typename Function, typename Wrt, typename Args>
+auto gradient(const Function& f, Wrt&& wrt, Args&& args, std::size_t nthreads = 0) -> Eigen::VectorXd
+{
+    using Result = decltype(std::apply(f, args));
+    Result u;
+    return gradient(f, std::forward<Wrt>(wrt), std::forward<Args>(args), u, nthreads);
+}
+
+/// Return the Jacobian matrix of a function *f* with respect to some or all variables,
+/// evaluating disjoint column chunks on *nthreads* threads (0 for all hardware threads).
+template<typename Function, typename Wrt, typename Args, typename Result>
+auto jacobian(const Function& f, Wrt&& wrt, Args&& args, Result& F, std::size_t nthreads = 0) -> Eigen::MatrixXd
+{
+    const auto items = detail::flatten(wrt);
+    const Eigen::Index n = items.size();
+
+    if(n == 0) return {};
+
+    using Item = std::decay_t<decltype(*items[0])>;
+    constexpr auto N = detail::GradWidth<decltype(Item::grad)>::value;
+
+    Eigen::MatrixXd J;
+
+    const auto evaluate = [&](const std::vector<Item*>& vars, auto& myargs, Result& result, Eigen::Index c) {
+        const auto width = std::min<Eigen::Index>(N, n - c);
+        detail::seedChunk(vars, c, width, 1.0);
+        result = std::apply(f, myargs);
+        detail::seedChunk(vars, c, width, 0.0);
+        if(c == 0)
+            J.resize(result.size(), n);
+        for(auto k = 0; k < width; ++k)
+            for(auto i = 0; i < result.size(); ++i)
+                J(i, c + k) = detail::direction(result[i].grad, k);
+    };
+
+    // The first chunk runs serially to size J and to return F
+    evaluate(items, args, F, 0);
+
+    const std::size_t nchunks = (n + N - 1) / N;
+    detail::run(args, items, 1, nchunks, nthreads, [&](const auto& vars, auto& myargs, std::size_t chunk) {
+        Result result;
+        evaluate(vars, myargs, result, chunk * N);
+    });
+
+    return J;
+}
+
+/// Return the Jacobian matrix of a function *f* with respect to some or all variables.
+template<typename Function, typename Wrt, typename Args>
+auto jacobian(const Function& f, Wrt&& wrt, Args&& args, std::size_t nthreads = 0) -> Eigen::MatrixXd
+{
+    using Result = decltype(std::apply(f, args));
+    Result F;
+    return jacobian(f, std::forward<Wrt>(wrt), std::forward<Args>(args), F, nthreads);
+}
+
+/// Return the hessian matrix of scalar function *f* with respect to some or all variables *x*,
+/// evaluating the rows of the upper triangle on *nthreads* threads (0 for all hardware threads).
+template<typename Function, typename Wrt, typename Args, typename Result, typename Gradient>
+auto hessian(const Function& f, Wrt&& wrt, Args&& args, Result& u, Gradient& g, std::size_t nthreads = 0) -> Eigen::MatrixXd
+{
+    const auto items = detail::flatten(wrt);
+    const Eigen::Index n = items.size();
+
+    Eigen::MatrixXd H(n, n);
+    g.resize(n);
+
+    if(n == 0) return H;
+
+    const auto row = [&](const auto& vars, auto& myargs, Result& result, Eigen::Index i) {
+        std::vector<Eigen::Index> cols;
+        for(auto j = i; j < n; ++j)
+            cols.push_back(j);
+        detail::hessianRow(f, vars, myargs, result, H, g, i, cols);
+    };
+
+    row(items, args, u, 0);
+
+    detail::run(args, items, 1, n, nthreads, [&](const auto& vars, auto& myargs, std::size_t i) {
+        Result result;
+        row(vars, myargs, result, i);
+    });
+
+    return H;
+}
+
+/// Return the hessian matrix of scalar function *f* with respect to some or all variables *x*.
+template<typename Function, typename Wrt, typename Args>
+auto hessian(const Function& f, Wrt&& wrt, Args&& args, std::size_t nthreads = 0) -> Eigen::MatrixXd
+{
+    using Result = decltype(std::apply(f, args));
+    Result u;
+    Eigen::VectorXd g;
+    return hessian(f, std::forward<Wrt>(wrt), std::forward<Args>(args), u, g, nthreads);
+}
+
+} // namespace autodiff::forward::parallel
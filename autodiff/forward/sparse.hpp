@@ -0,0 +1,256 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright (c) 2018-2020 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// C++ includes
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <vector>
+
+// Eigen includes
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+
+// autodiff includes
+#include <autodiff/forward/eigen.hpp>
+
+//------------------------------------------------------------------------------
+// SPARSE JACOBIANS VIA SPARSITY DETECTION AND COLUMN COLORING
+//------------------------------------------------------------------------------
+namespace autodiff::forward::sparse {
+
+/// Sorted set of input indices, used as the grad type of a Dual to detect
+/// which inputs each value structurally depends on. Scaling keeps the set and
+/// adding takes the union, so no derivative value is ever computed. Numbers
+/// (e.g. `grad = 0`) have an empty set.
+struct IndexSet
+{
+    std::vector<Eigen::Index> indices;
+
+    IndexSet() = default;
+
+    template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+    IndexSet(U) {}
+
+    static auto single(Eigen::Index i) -> IndexSet { IndexSet s; s.indices.push_back(i); return s; }
+
+    template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+    IndexSet& operator=(U) { indices.clear(); return *this; }
+
+    auto operator+=(const IndexSet& other) -> IndexSet&
+    {
+        if(other.indices.empty()) return *this;
+        std::vector<Eigen::Index> merged;
+        merged.reserve(indices.size() + other.indices.size());
+        std::set_union(indices.begin(), indices.end(), other.indices.begin(), other.indices.end(), std::back_inserter(merged));
+        indices.swap(merged);
+        return *this;
+    }
+
+    auto operator-=(const IndexSet& other) -> IndexSet& { return *this += other; }
+
+    template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+    auto operator*=(U) -> IndexSet& { return *this; }
+
+    template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+    auto operator/=(U) -> IndexSet& { return *this; }
+
+    auto operator-() const -> IndexSet { return *this; }
+};
+
+template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+auto operator*(U, const IndexSet& s) -> IndexSet { return s; }
+
+template<typename U, std::enable_if_t<std::is_arithmetic_v<U>, int> = 0>
+auto operator*(const IndexSet& s, U) -> IndexSet { return s; }
+
+/// Dual number propagating sparsity patterns instead of derivatives
+using PatternDual = Dual<double, IndexSet>;
+
+} // namespace autodiff::forward::sparse
+
+namespace autodiff::forward::traits {
+
+template<>
+struct GradType<sparse::IndexSet> { using type = sparse::IndexSet; };
+
+} // namespace autodiff::forward::traits
+
+namespace autodiff::forward::sparse {
+
+/// Return the sparsity pattern of the Jacobian of the vector function *f* at *x*.
+/// *f* must accept an Eigen vector of any dual type (e.g. a generic lambda). The
+/// pattern is structural: it holds for every *x* at which *f* takes the same branches.
+template<typename Function, typename Vector>
+auto pattern(const Function& f, const Vector& x) -> Eigen::SparseMatrix<bool>
+{
+    const Eigen::Index n = x.size();
+
+    Eigen::Matrix<PatternDual, Eigen::Dynamic, 1> xp(n);
+    for(auto j = 0; j < n; ++j)
+    {
+        xp[j].val = x[j];
+        xp[j].grad = IndexSet::single(j);
+    }
+
+    const auto F = f(xp);
+
+    std::vector<Eigen::Triplet<bool>> triplets;
+    for(auto i = 0; i < F.size(); ++i)
+        for(auto j : F[i].grad.indices)
+            triplets.emplace_back(i, j, true);
+
+    Eigen::SparseMatrix<bool> P(F.size(), n);
+    P.setFromTriplets(triplets.begin(), triplets.end());
+    return P;
+}
+
+/// Return a greedy coloring of the columns of *P* such that no two columns of
+/// the same color have a nonzero in the same row.
+inline auto coloring(const Eigen::SparseMatrix<bool>& P) -> std::vector<Eigen::Index>
+{
+    const Eigen::Index n = P.cols();
+    const Eigen::SparseMatrix<bool, Eigen::RowMajor> R = P;
+
+    std::vector<Eigen::Index> color(n, -1);
+    std::vector<Eigen::Index> forbidden(n + 1, -1); // forbidden[c] == j if color c is taken by a neighbor of j
+
+    for(auto j = 0; j < n; ++j)
+    {
+        for(Eigen::SparseMatrix<bool>::InnerIterator row(P, j); row; ++row)
+            for(Eigen::SparseMatrix<bool, Eigen::RowMajor>::InnerIterator col(R, row.row()); col; ++col)
+                if(color[col.col()] >= 0)
+                    forbidden[color[col.col()]] = j;
+
+        Eigen::Index c = 0;
+        while(forbidden[c] == j) ++c;
+        color[j] = c;
+    }
+
+    return color;
+}
+
+/// Return the Jacobian of the vector function *f* at *x* with the sparsity pattern *P*.
+/// Columns of equal color are seeded together, so *f* is evaluated once per color
+/// (or once per N colors when *DualType* is a vector-mode dual such as dual8).
+template<typename DualType = dual, typename Function, typename Vector>
+auto jacobian(const Function& f, const Vector& x, const Eigen::SparseMatrix<bool>& P) -> Eigen::SparseMatrix<double>
+{
+    const Eigen::Index n = x.size();
+    const auto color = coloring(P);
+    const Eigen::Index ncolors = n ? *std::max_element(color.begin(), color.end()) + 1 : 0;
+
+    std::vector<std::vector<Eigen::Index>> columns(ncolors);
+    for(auto j = 0; j < n; ++j)
+        columns[color[j]].push_back(j);
+
+    using G = decltype(DualType::grad);
+    constexpr auto N = detail::GradWidth<G>::value;
+
+    Eigen::Matrix<DualType, Eigen::Dynamic, 1> xd(n);
+    for(auto j = 0; j < n; ++j)
+        xd[j] = x[j];
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(P.nonZeros());
+
+    for(Eigen::Index c = 0; c < ncolors; c += N)
+    {
+        const auto width = std::min<Eigen::Index>(N, ncolors - c);
+        for(auto k = 0; k < width; ++k)
+            for(auto j : columns[c + k])
+                detail::seedDirection(xd[j].grad, k, 1.0);
+
+        const auto F = f(xd);
+
+        for(auto k = 0; k < width; ++k)
+            for(auto j : columns[c + k])
+            {
+                xd[j].grad = 0.0;
+                for(Eigen::SparseMatrix<bool>::InnerIterator it(P, j); it; ++it)
+                    triplets.emplace_back(it.row(), j, detail::direction(F[it.row()].grad, k));
+            }
+    }
+
+    Eigen::SparseMatrix<double> J(P.rows(), n);
+    J.setFromTriplets(triplets.begin(), triplets.end());
+    return J;
+}
+
+/// Return the Jacobian of the vector function *f* at *x*, detecting its sparsity pattern first.
+template<typename DualType = dual, typename Function, typename Vector>
+auto jacobian(const Function& f, const Vector& x) -> Eigen::SparseMatrix<double>
+{
+    return jacobian<DualType>(f, x, pattern(f, x));
+}
+
+/// Return the hessian matrix of scalar function *f* with respect to some or all variables *x*,
+/// evaluating only the entries j >= i in the sparsity pattern *P* (either triangle may be given).
+/// Entries outside *P* are zero. Every row still costs at least one evaluation for the gradient.
+template<typename Function, typename Wrt, typename Args, typename Result, typename Gradient>
+auto hessian(const Function& f, Wrt&& wrt, Args&& args, Result& u, Gradient& g, const Eigen::SparseMatrix<bool>& P) -> Eigen::MatrixXd
+{
+    const auto items = detail::flatten(wrt);
+    const Eigen::Index n = items.size();
+
+    assert(P.rows() == n && P.cols() == n);
+
+    // Upper triangle of P + P^T, one column list per row
+    std::vector<std::vector<Eigen::Index>> cols(n);
+    for(auto j = 0; j < n; ++j)
+        for(Eigen::SparseMatrix<bool>::InnerIterator it(P, j); it; ++it)
+            cols[std::min<Eigen::Index>(it.row(), j)].push_back(std::max<Eigen::Index>(it.row(), j));
+    for(auto& c : cols)
+    {
+        std::sort(c.begin(), c.end());
+        c.erase(std::unique(c.begin(), c.end()), c.end());
+    }
+
+    Eigen::MatrixXd H = Eigen::MatrixXd::Zero(n, n);
+    g.resize(n);
+
+    for(auto i = 0; i < n; ++i)
+        detail::hessianRow(f, items, args, u, H, g, i, cols[i]);
+
+    return H;
+}
+
+/// Return the hessian matrix of scalar function *f* with the sparsity pattern *P*.
+template<typename Function, typename Wrt, typename Args>
+auto hessian(const Function& f, Wrt&& wrt, Args&& args, const Eigen::SparseMatrix<bool>& P) -> Eigen::MatrixXd
+{
+    using Result = decltype(std::apply(f, args));
+    Result u;
+    Eigen::VectorXd g;
+    return hessian(f, std::forward<Wrt>(wrt), std::forward<Args>(args), u, g, P);
+}
+
+} // namespace autodiff::forward::sparse
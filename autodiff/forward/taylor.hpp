@@ -0,0 +1,422 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright (c) 2018-2020 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+// C++ includes
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <tuple>
+#include <type_traits>
+
+// autodiff includes
+#include <autodiff/forward/forward.hpp>
+
+namespace autodiff {
+namespace forward {
+
+//=====================================================================================================================
+//
+// TRUNCATED TAYLOR SERIES
+//
+//=====================================================================================================================
+
+/// Univariate Taylor polynomial of degree N: c[k] = f^(k)(x0) / k!.
+/// Every operation propagates all N+1 coefficients with the standard
+/// convolution recurrences, i.e. O(N^2) work per operation, whereas
+/// HigherOrderDual<N> holds 2^N components.
+template<std::size_t N, typename T = double>
+struct Taylor
+{
+    std::array<T, N + 1> c = {};
+
+    Taylor() = default;
+
+    template<typename U, enableif<std::is_arithmetic_v<U>>...>
+    Taylor(U val) { c[0] = static_cast<T>(val); }
+
+    explicit operator T() const { return c[0]; }
+
+    T& operator[](std::size_t k) { return c[k]; }
+
+    const T& operator[](std::size_t k) const { return c[k]; }
+
+    Taylor& operator+=(const Taylor& other) { for(std::size_t k = 0; k <= N; ++k) c[k] += other.c[k]; return *this; }
+    Taylor& operator-=(const Taylor& other) { for(std::size_t k = 0; k <= N; ++k) c[k] -= other.c[k]; return *this; }
+    Taylor& operator*=(const Taylor& other) { return *this = *this * other; }
+    Taylor& operator/=(const Taylor& other) { return *this = *this / other; }
+
+    template<typename U, enableif<std::is_arithmetic_v<U>>...>
+    Taylor& operator+=(U s) { c[0] += s; return *this; }
+
+    template<typename U, enableif<std::is_arithmetic_v<U>>...>
+    Taylor& operator-=(U s) { c[0] -= s; return *this; }
+
+    template<typename U, enableif<std::is_arithmetic_v<U>>...>
+    Taylor& operator*=(U s) { for(auto& ck : c) ck *= s; return *this; }
+
+    template<typename U, enableif<std::is_arithmetic_v<U>>...>
+    Taylor& operator/=(U s) { for(auto& ck : c) ck /= s; return *this; }
+};
+
+namespace internal {
+
+/// Return y with y_0 = y0 and y' = g x', i.e. y_k = (1/k) sum_{j=1..k} j x_j g_{k-j}
+template<std::size_t N, typename T>
+auto integrate(const Taylor<N, T>& x, const Taylor<N, T>& g, T y0) -> Taylor<N, T>
+{
+    Taylor<N, T> y;
+    y[0] = y0;
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T s = 0;
+        for(std::size_t j = 1; j <= k; ++j)
+            s += T(j) * x[j] * g[k - j];
+        y[k] = s / T(k);
+    }
+    return y;
+}
+
+} // namespace internal
+
+//=====================================================================================================================
+//
+// ARITHMETIC OPERATORS
+//
+//=====================================================================================================================
+
+template<std::size_t N, typename T>
+auto operator+(const Taylor<N, T>& x) { return x; }
+
+template<std::size_t N, typename T>
+auto operator-(Taylor<N, T> x) { for(auto& ck : x.c) ck = -ck; return x; }
+
+template<std::size_t N, typename T>
+auto operator+(Taylor<N, T> a, const Taylor<N, T>& b) { return a += b; }
+
+template<std::size_t N, typename T>
+auto operator-(Taylor<N, T> a, const Taylor<N, T>& b) { return a -= b; }
+
+template<std::size_t N, typename T>
+auto operator*(const Taylor<N, T>& a, const Taylor<N, T>& b)
+{
+    Taylor<N, T> y;
+    for(std::size_t k = 0; k <= N; ++k)
+        for(std::size_t j = 0; j <= k; ++j)
+            y[k] += a[j] * b[k - j];
+    return y;
+}
+
+template<std::size_t N, typename T>
+auto operator/(const Taylor<N, T>& a, const Taylor<N, T>& b)
+{
+    Taylor<N, T> y;
+    for(std::size_t k = 0; k <= N; ++k)
+    {
+        T s = a[k];
+        for(std::size_t j = 0; j < k; ++j)
+            s -= y[j] * b[k - j];
+        y[k] = s / b[0];
+    }
+    return y;
+}
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator+(Taylor<N, T> a, U s) { return a += s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator+(U s, Taylor<N, T> a) { return a += s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator-(Taylor<N, T> a, U s) { return a -= s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator-(U s, const Taylor<N, T>& a) { return -a + s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator*(Taylor<N, T> a, U s) { return a *= s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator*(U s, Taylor<N, T> a) { return a *= s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator/(Taylor<N, T> a, U s) { return a /= s; }
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto operator/(U s, const Taylor<N, T>& a) { return Taylor<N, T>(s) / a; }
+
+//=====================================================================================================================
+//
+// COMPARISON OPERATORS
+//
+//=====================================================================================================================
+
+template<std::size_t N, typename T> bool operator==(const Taylor<N, T>& a, const Taylor<N, T>& b) { return a[0] == b[0]; }
+template<std::size_t N, typename T> bool operator!=(const Taylor<N, T>& a, const Taylor<N, T>& b) { return a[0] != b[0]; }
+template<std::size_t N, typename T> bool operator<=(const Taylor<N, T>& a, const Taylor<N, T>& b) { return a[0] <= b[0]; }
+template<std::size_t N, typename T> bool operator>=(const Taylor<N, T>& a, const Taylor<N, T>& b) { return a[0] >= b[0]; }
+template<std::size_t N, typename T> bool operator<(const Taylor<N, T>& a, const Taylor<N, T>& b) { return a[0] < b[0]; }
+template<std::size_t N, typename T> bool operator>(const Taylor<N, T>& a, const Taylor<N, T>& b) { return a[0] > b[0]; }
+
+//=====================================================================================================================
+//
+// EXPONENTIAL AND LOGARITHMIC FUNCTIONS
+//
+//=====================================================================================================================
+
+template<std::size_t N, typename T>
+auto exp(const Taylor<N, T>& x)
+{
+    Taylor<N, T> y;
+    y[0] = std::exp(x[0]);
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T s = 0;
+        for(std::size_t j = 1; j <= k; ++j)
+            s += T(j) * x[j] * y[k - j];
+        y[k] = s / T(k);
+    }
+    return y;
+}
+
+template<std::size_t N, typename T>
+auto log(const Taylor<N, T>& x)
+{
+    Taylor<N, T> y;
+    y[0] = std::log(x[0]);
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T s = 0;
+        for(std::size_t j = 1; j < k; ++j)
+            s += T(j) * y[j] * x[k - j];
+        y[k] = (x[k] - s / T(k)) / x[0];
+    }
+    return y;
+}
+
+template<std::size_t N, typename T>
+auto log10(const Taylor<N, T>& x)
+{
+    constexpr T ln10 = 2.3025850929940456840179914546843;
+    return log(x) / ln10;
+}
+
+//=====================================================================================================================
+//
+// POWER FUNCTIONS
+//
+//=====================================================================================================================
+
+template<std::size_t N, typename T>
+auto sqrt(const Taylor<N, T>& x)
+{
+    Taylor<N, T> y;
+    y[0] = std::sqrt(x[0]);
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T s = x[k];
+        for(std::size_t j = 1; j < k; ++j)
+            s -= y[j] * y[k - j];
+        y[k] = s / (2 * y[0]);
+    }
+    return y;
+}
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto pow(const Taylor<N, T>& x, U r)
+{
+    // The recurrence below divides by x_0; at x_0 = 0 use repeated squaring for natural powers
+    if(x[0] == 0 && r >= 0 && std::floor(r) == r)
+    {
+        Taylor<N, T> y(1), base = x;
+        for(auto e = static_cast<unsigned long long>(r); e; e >>= 1, base = base * base)
+            if(e & 1) y = y * base;
+        return y;
+    }
+
+    // y_k = 1/(k x_0) sum_{j=0..k-1} (r (k - j) - j) x_{k-j} y_j
+    Taylor<N, T> y;
+    y[0] = std::pow(x[0], static_cast<T>(r));
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T s = 0;
+        for(std::size_t j = 0; j < k; ++j)
+            s += (static_cast<T>(r) * T(k - j) - T(j)) * x[k - j] * y[j];
+        y[k] = s / (T(k) * x[0]);
+    }
+    return y;
+}
+
+template<std::size_t N, typename T, typename U, enableif<std::is_arithmetic_v<U>>...>
+auto pow(U a, const Taylor<N, T>& x) { return exp(std::log(static_cast<T>(a)) * x); }
+
+template<std::size_t N, typename T>
+auto pow(const Taylor<N, T>& a, const Taylor<N, T>& b) { return exp(b * log(a)); }
+
+//=====================================================================================================================
+//
+// TRIGONOMETRIC AND HYPERBOLIC FUNCTIONS
+//
+//=====================================================================================================================
+
+namespace internal {
+
+/// Return (sin x, cos x) if sign = -1 or (sinh x, cosh x) if sign = +1
+template<std::size_t N, typename T>
+auto sincos(const Taylor<N, T>& x, T sign) -> std::array<Taylor<N, T>, 2>
+{
+    Taylor<N, T> s, c;
+    s[0] = sign < 0 ? std::sin(x[0]) : std::sinh(x[0]);
+    c[0] = sign < 0 ? std::cos(x[0]) : std::cosh(x[0]);
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T ss = 0, cc = 0;
+        for(std::size_t j = 1; j <= k; ++j)
+        {
+            ss += T(j) * x[j] * c[k - j];
+            cc += T(j) * x[j] * s[k - j];
+        }
+        s[k] = ss / T(k);
+        c[k] = sign * cc / T(k);
+    }
+    return { s, c };
+}
+
+/// Return tan x if sign = +1 or tanh x if sign = -1, using y' = (1 + sign y^2) x'
+template<std::size_t N, typename T>
+auto tan(const Taylor<N, T>& x, T sign) -> Taylor<N, T>
+{
+    Taylor<N, T> y, w; // w = 1 + sign y^2
+    y[0] = sign > 0 ? std::tan(x[0]) : std::tanh(x[0]);
+    w[0] = 1 + sign * y[0] * y[0];
+    for(std::size_t k = 1; k <= N; ++k)
+    {
+        T s = 0;
+        for(std::size_t j = 1; j <= k; ++j)
+            s += T(j) * x[j] * w[k - j];
+        y[k] = s / T(k);
+        T yy = 0;
+        for(std::size_t j = 0; j <= k; ++j)
+            yy += y[j] * y[k - j];
+        w[k] = sign * yy;
+    }
+    return y;
+}
+
+} // namespace internal
+
+template<std::size_t N, typename T> auto sin(const Taylor<N, T>& x) { return internal::sincos(x, T(-1))[0]; }
+template<std::size_t N, typename T> auto cos(const Taylor<N, T>& x) { return internal::sincos(x, T(-1))[1]; }
+template<std::size_t N, typename T> auto tan(const Taylor<N, T>& x) { return internal::tan(x, T(1)); }
+template<std::size_t N, typename T> auto sinh(const Taylor<N, T>& x) { return internal::sincos(x, T(1))[0]; }
+template<std::size_t N, typename T> auto cosh(const Taylor<N, T>& x) { return internal::sincos(x, T(1))[1]; }
+template<std::size_t N, typename T> auto tanh(const Taylor<N, T>& x) { return internal::tan(x, T(-1)); }
+
+template<std::size_t N, typename T>
+auto asin(const Taylor<N, T>& x) { return internal::integrate(x, 1 / sqrt(1 - x * x), std::asin(x[0])); }
+
+template<std::size_t N, typename T>
+auto acos(const Taylor<N, T>& x) { return internal::integrate(x, -1 / sqrt(1 - x * x), std::acos(x[0])); }
+
+template<std::size_t N, typename T>
+auto atan(const Taylor<N, T>& x) { return internal::integrate(x, 1 / (1 + x * x), std::atan(x[0])); }
+
+//=====================================================================================================================
+//
+// OTHER FUNCTIONS
+//
+//=====================================================================================================================
+
+template<std::size_t N, typename T>
+auto abs(const Taylor<N, T>& x) { return x[0] < 0 ? -x : x; }
+
+template<std::size_t N, typename T>
+auto erf(const Taylor<N, T>& x)
+{
+    constexpr T sqrt_pi = 1.7724538509055160272981674833411451872554456638435;
+    return internal::integrate(x, (2 / sqrt_pi) * exp(-(x * x)), std::erf(x[0]));
+}
+
+template<std::size_t N, typename T>
+std::ostream& operator<<(std::ostream& out, const Taylor<N, T>& x)
+{
+    out << x[0];
+    return out;
+}
+
+//=====================================================================================================================
+//
+// DERIVATIVES
+//
+//=====================================================================================================================
+
+/// Return the k-th derivative of the function whose Taylor series is *y*
+template<std::size_t k, std::size_t N, typename T>
+auto derivative(const Taylor<N, T>& y) -> T
+{
+    static_assert(k <= N, "Taylor: derivative order exceeds the series degree");
+    T factorial = 1;
+    for(std::size_t i = 2; i <= k; ++i)
+        factorial *= T(i);
+    return factorial * y[k];
+}
+
+/// Return the derivatives of order 0..N of the function whose Taylor series is *y*
+template<std::size_t N, typename T>
+auto derivatives(const Taylor<N, T>& y) -> std::array<T, N + 1>
+{
+    std::array<T, N + 1> d;
+    T factorial = 1;
+    for(std::size_t k = 0; k <= N; ++k)
+    {
+        if(k > 1) factorial *= T(k);
+        d[k] = factorial * y[k];
+    }
+    return d;
+}
+
+/// Return the derivatives of order 0..N of *f* along the direction in which every
+/// variable in *wrt* moves with unit speed (a single variable gives plain derivatives).
+template<typename Function, typename... Wrt, typename Args>
+auto derivatives(const Function& f, std::tuple<Wrt&...> wrt, Args&& args)
+{
+    std::apply([](auto&... x) { ((x[1] = 1), ...); }, wrt);
+    const auto y = std::apply(f, args);
+    std::apply([](auto&... x) { ((x[1] = 0), ...); }, wrt);
+    return derivatives(y);
+}
+
+} // namespace forward
+
+using forward::Taylor;
+using forward::derivatives;
+
+} // namespace autodiff
@@ -107,7 +107,7 @@ auto gradient(const Variable<T>& y, Eigen::DenseBase<X>& x)
     for(auto i = 0; i < n; ++i)
         x[i].seed();
 
-    y.expr->propagate(1.0);
+    backward(y.expr);
 
     Vec<U, Rows, MaxRows> g(n);
     for(auto i = 0; i < n; ++i)
@@ -148,7 +148,7 @@ auto hessian(const Variable<T>& y, Eigen::DenseBase<X>& x, Vec& g)
             x[k].seed();
 
         auto dydxi = x[i].gradx();
-        dydxi->propagate(1.0);
+        backward(dydxi);
 
         for(auto j = i; j < n; ++j)
             H(i, j) = H(j, i) = val(x[j].grad());
@@ -168,9 +168,57 @@ auto hessian(const Variable<T>& y, Eigen::DenseBase<X>& x)
     return hessian(y, x, g);
 }
 
+/// Return the product of the Hessian matrix of variable y with respect to variables x and a vector v.
+/// The expression graph of y is swept once forward, for the directional derivatives along v, and once in reverse, for the
+/// derivatives and their directional derivatives, so no expression graph of the gradient is built. As a by-product, the
+/// gradient of y is left in the variables x.
+template<typename T, typename X, typename V>
+auto hvp(const Variable<T>& y, Eigen::DenseBase<X>& x, const Eigen::DenseBase<V>& v)
+{
+    using U = VariableValueType<T>;
+
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+
+    constexpr auto Rows = X::RowsAtCompileTime;
+    constexpr auto MaxRows = X::MaxRowsAtCompileTime;
+
+    const auto n = x.size();
+    assert(v.size() == n);
+
+    std::vector<Expr<T>*> vec;
+    y.expr->topology_sort(vec);
+
+    for(auto e : vec)
+        e->dot = e->grad = e->grad_dot = 0.0;
+
+    for(auto i = 0; i < n; ++i)
+    {
+        x[i].expr->dot = v[i];
+        x[i].expr->grad = x[i].expr->grad_dot = 0.0;
+    }
+
+    for(auto e : vec)
+        e->tangent_step();
+
+    y.expr->grad = 1.0;
+    for(auto it = vec.rbegin(); it != vec.rend(); ++it)
+        (*it)->propagate_tangent_step();
+
+    for(auto e : vec)
+        e->color = 0;
+
+    Vec<U, Rows, MaxRows> Hv(n);
+    for(auto i = 0; i < n; ++i)
+        Hv[i] = val(x[i].expr->grad_dot);
+
+    return Hv;
+}
+
 } // namespace reverse
 
 using reverse::gradient;
 using reverse::hessian;
+using reverse::hvp;
 
 } // namespace autodiff
@@ -42,6 +42,9 @@
 #include <functional>
 #include <atomic>
 #include <stack>
+#include <map>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 // autodiff includes
@@ -89,9 +92,14 @@ template<typename T> struct ErfExpr;
 template<typename T> struct Variable;
 template<typename T> struct SigmoidExpr;
 template<typename T> struct ReLUExpr;
+template<typename T> struct CheckpointExpr;
+template<typename T> struct CheckpointOutputExpr;
 
 template<typename T> using ExprPtr = std::shared_ptr<Expr<T>>;
 
+/// The kind of an expression node, used for cheap type tests in the graph passes.
+enum class ExprKind : char { Other, Independent, Dependent, Constant, Add, Mul, Sum, Prod };
+
 namespace traits {
 
 template<typename T>
@@ -238,11 +246,23 @@ struct Expr
     /// The derivative of the root expression node with respect to this variable (as an expression for higher-order derivatives).
     ExprPtr<T> gradx = {};
 
+    /// The directional derivative of this expression along the direction seeded by @ref hvp.
+    T dot = {};
+
+    /// The directional derivative of `grad` along the direction seeded by @ref hvp.
+    T grad_dot = {};
+
     /// Construct an Expr object with given value.
     explicit Expr(const T& val) : val(val) {}
 
     virtual void propagate_step() = 0;
 
+    /// Compute `dot` from the directional derivatives of the children (the forward sweep of a Hessian-vector product).
+    virtual void tangent_step() { }
+
+    /// Like propagate_step, but also propagate `grad_dot` to the children (the reverse sweep of a Hessian-vector product).
+    virtual void propagate_tangent_step() { }
+
     /// Update the contribution of this expression in the derivative of the root node of the expression tree.
     /// @param wprime The derivative of the root expression node w.r.t. the child expression of this expression node.
     virtual void propagate(const T& wprime) = 0;
@@ -255,6 +275,9 @@ struct Expr
 
     virtual const char* name() = 0;
 
+    /// The size of this expression node in bytes, not counting the containers and expressions it refers to.
+    virtual std::size_t bytes() { return sizeof(*this); }
+
     virtual void print(int indent) 
     { 
       std::cout << std::string(indent, ' ') << name() << std::endl;
@@ -262,23 +285,72 @@ struct Expr
 
     virtual void children_do(std::function<void(Expr<T>*)> fn) { }
 
+    /// The kind of this expression node.
+    ExprKind kind = ExprKind::Other;
+
     /// The color in topology_sort
     char color = {};
 
-    void topology_sort(std::vector<Expr<T>*>& vec) 
+    /// Whether rewrite() has already been applied to the subtree rooted at this expression.
+    bool rewritten = false;
+
+    /// Whether derivatives with respect to this expression are needed, i.e. whether it depends on an independent variable that requires a gradient.
+    /// This is propagated when the expression is constructed; expressions that do not require a gradient are never entered by topology_sort.
+    bool requires_grad = true;
+
+    /// Fold the children of this expression that do not require a gradient into constants, and update `requires_grad` accordingly.
+    /// The children are expected to have been folded already.
+    virtual void fold_step() { }
+
+    /// Replace an expression that does not require a gradient with a constant holding its value (leaves are kept as they are).
+    static void fold_child(ExprPtr<T>& x)
+    {
+      if(!x->requires_grad && x->kind != ExprKind::Constant && x->kind != ExprKind::Independent) {
+        x = constant<T>(x->val);
+      }
+    }
+
+    /// Append the nodes of the expression graph rooted at this expression to *vec* in topological order (children first).
+    /// Nodes already colored, e.g. by an earlier sort into the same *vec*, are skipped; the caller resets the colors.
+    /// The depth-first search keeps its own stack, so deep graphs do not overflow the call stack.
+    void topology_sort(std::vector<Expr<T>*>& vec)
     {
       if(this->color) return;
       this->color = 1;
 
-      this->children_do([&](auto x){x->topology_sort(vec); });
+      // Each frame is a node and the position of its next child in `children`, where its children start at `begin`
+      struct Frame { Expr<T>* e; std::size_t begin, next; };
+      std::vector<Frame> stack;
+      std::vector<Expr<T>*> children;
+
+      auto push = [&](Expr<T>* e) {
+        const auto begin = children.size();
+        e->children_do([&](auto x){ if(x->requires_grad) children.push_back(x); });
+        stack.push_back({ e, begin, begin });
+      };
 
-      this->color = 2;
-      vec.push_back(this);
+      push(this);
+      while(!stack.empty()) {
+        auto& top = stack.back();
+        if(top.next < children.size()) {
+          auto x = children[top.next++];
+          if(!x->color) {
+            x->color = 1;
+            push(x);
+          }
+          continue;
+        }
+        top.e->color = 2;
+        vec.push_back(top.e);
+        children.resize(top.begin);
+        stack.pop_back();
+      }
     }
 };
 
 #define DECLARE_NAME(x) \
-    virtual const char* name() { return #x; }
+    virtual const char* name() { return #x; } \
+    virtual std::size_t bytes() { return sizeof(*this); }
 
 /// The node in the expression tree representing either an independent or dependent variable.
 template<typename T>
@@ -303,6 +375,7 @@ struct IndependentVariableExpr : VariableExpr<T>
     /// Construct an IndependentVariableExpr object with given value.
     IndependentVariableExpr(const T& val) : VariableExpr<T>(val)
     {
+        this->kind = ExprKind::Independent;
         gradx = constant<T>(0.0); // TODO: Check if this can be done at the seed function.
     }
 
@@ -335,6 +408,8 @@ struct DependentVariableExpr : VariableExpr<T>
     /// Construct an DependentVariableExpr object with given value.
     DependentVariableExpr(const ExprPtr<T>& expr) : VariableExpr<T>(expr->val), expr(expr)
     {
+        this->kind = ExprKind::Dependent;
+        this->requires_grad = expr->requires_grad;
         gradx = constant<T>(0.0); // TODO: Check if this can be done at the seed function.
     }
 
@@ -342,6 +417,17 @@ struct DependentVariableExpr : VariableExpr<T>
       expr->grad += this->grad;
     }
 
+    virtual void tangent_step()
+    {
+      this->dot = expr->dot;
+    }
+
+    virtual void propagate_tangent_step()
+    {
+      expr->grad += this->grad;
+      expr->grad_dot += this->grad_dot;
+    }
+
     virtual void propagate(const T& wprime)
     {
         grad += wprime;
@@ -355,6 +441,8 @@ struct DependentVariableExpr : VariableExpr<T>
     }
 
     virtual ExprPtr<T> rewrite() {
+      if(this->rewritten) return nullptr;
+      this->rewritten = true;
       auto child = expr->rewrite();
       if(child) {
         expr = child;
@@ -362,6 +450,12 @@ struct DependentVariableExpr : VariableExpr<T>
       return nullptr;
     }
 
+    virtual void fold_step()
+    {
+      this->fold_child(expr);
+      this->requires_grad = expr->requires_grad;
+    }
+
     virtual void print(int indent) 
     { 
       this->Expr<T>::print(indent);
@@ -379,7 +473,11 @@ struct ConstantExpr : Expr<T>
 {
     DECLARE_NAME(ConstantExpr);
 
-    using Expr<T>::Expr;
+    explicit ConstantExpr(const T& val) : Expr<T>(val)
+    {
+        this->kind = ExprKind::Constant;
+        this->requires_grad = false;
+    }
 
     virtual void propagate_step() 
     {}
@@ -398,9 +496,26 @@ struct UnaryExpr : Expr<T>
 
     ExprPtr<T> x;
 
-    UnaryExpr(const T& val, const ExprPtr<T>& x) : Expr<T>(val), x(x) {}
+    UnaryExpr(const T& val, const ExprPtr<T>& x) : Expr<T>(val), x(x) { this->requires_grad = x->requires_grad; }
+
+    /// The first and second derivatives of this expression with respect to its operand (used by Hessian-vector products).
+    virtual std::array<T, 2> partials() = 0;
+
+    virtual void tangent_step()
+    {
+      this->dot = partials()[0] * x->dot;
+    }
+
+    virtual void propagate_tangent_step()
+    {
+      const auto d = partials();
+      x->grad += this->grad * d[0];
+      x->grad_dot += this->grad_dot * d[0] + this->grad * d[1] * x->dot;
+    }
 
     virtual ExprPtr<T> rewrite() {
+      if(this->rewritten) return nullptr;
+      this->rewritten = true;
       auto child = x->rewrite();
       if(child) {
         x = child;
@@ -408,6 +523,12 @@ struct UnaryExpr : Expr<T>
       return nullptr;
     }
 
+    virtual void fold_step()
+    {
+      this->fold_child(x);
+      this->requires_grad = x->requires_grad;
+    }
+
     virtual void print(int indent) 
     { 
       this->Expr<T>::print(indent);
@@ -444,6 +565,11 @@ struct NegativeExpr : UnaryExpr<T>
     {
         x->propagatex(-wprime);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { T(-1.0), T(0.0) };
+    }
 };
 
 template<typename T>
@@ -453,9 +579,33 @@ struct BinaryExpr : Expr<T>
 
     ExprPtr<T> l, r;
 
-    BinaryExpr(const T& val, const ExprPtr<T>& l, const ExprPtr<T>& r) : Expr<T>(val), l(l), r(r) {}
+    /// The aggregated expression this expression was rewritten into by collect_rewrite(), if any.
+    ExprPtr<T> collected;
+
+    BinaryExpr(const T& val, const ExprPtr<T>& l, const ExprPtr<T>& r) : Expr<T>(val), l(l), r(r) { this->requires_grad = l->requires_grad || r->requires_grad; }
+
+    /// The first and second partial derivatives of this expression with respect to its operands, in the order
+    /// d/dl, d/dr, d2/dl2, d2/dldr and d2/dr2 (used by Hessian-vector products).
+    virtual std::array<T, 5> partials() = 0;
+
+    virtual void tangent_step()
+    {
+      const auto d = partials();
+      this->dot = d[0] * l->dot + d[1] * r->dot;
+    }
+
+    virtual void propagate_tangent_step()
+    {
+      const auto d = partials();
+      l->grad += this->grad * d[0];
+      r->grad += this->grad * d[1];
+      l->grad_dot += this->grad_dot * d[0] + this->grad * (d[2] * l->dot + d[3] * r->dot);
+      r->grad_dot += this->grad_dot * d[1] + this->grad * (d[3] * l->dot + d[4] * r->dot);
+    }
 
     virtual ExprPtr<T> rewrite() {
+      if(this->rewritten) return nullptr;
+      this->rewritten = true;
       auto cl = l->rewrite();
       auto cr = r->rewrite();
       if(cl) {
@@ -467,6 +617,13 @@ struct BinaryExpr : Expr<T>
       return nullptr;
     }
 
+    virtual void fold_step()
+    {
+      this->fold_child(l);
+      this->fold_child(r);
+      this->requires_grad = l->requires_grad || r->requires_grad;
+    }
+
     virtual void print(int indent) 
     { 
       this->Expr<T>::print(indent);
@@ -480,35 +637,42 @@ struct BinaryExpr : Expr<T>
       fn(r.get());
     }
 
+    /// Flatten a tree of binary expressions of type U (and aggregates V of them) rooted at this expression into a single aggregate V.
+    /// The result is memoized, so that further calls (e.g. from other parents of this expression) return the same aggregate.
     template<typename U, typename V> ExprPtr<T> collect_rewrite() {
 
-      auto ltyped = dynamic_cast<U*>(l.get());
-      auto rtyped = dynamic_cast<U*>(r.get());
+      if (this->rewritten) {
+        return collected;
+      }
 
-      if (!ltyped && !rtyped) {
+      if (l->kind != U::Kind && r->kind != U::Kind) {
         return this->BinaryExpr::rewrite();
       }
+      this->rewritten = true;
 
+      // Collect the operands from left to right, using a scratch stack that is reused across calls.
+      thread_local std::vector<const ExprPtr<T>*> stack;
       std::vector<ExprPtr<T>> elements;
-      std::function<void(const ExprPtr<T> &p)> collect;
-      collect = [&] (const ExprPtr<T> &p) {
-        auto ptyped = dynamic_cast<U*>(p.get());
-        auto paggregated = dynamic_cast<V*>(p.get());
-        if (paggregated) {
-          for(const auto& c: paggregated->elements) {
-            collect(c);
+      stack.clear();
+      stack.push_back(&this->r);
+      stack.push_back(&this->l);
+      while (!stack.empty()) {
+        const auto& p = *stack.back();
+        stack.pop_back();
+        if (p->kind == V::Kind) {
+          const auto& es = static_cast<V*>(p.get())->elements;
+          for(auto it = es.rbegin(); it != es.rend(); ++it) {
+            stack.push_back(&*it);
           }
-        } else if (ptyped) {
-          collect(ptyped->l);
-          collect(ptyped->r);
+        } else if (p->kind == U::Kind) {
+          stack.push_back(&static_cast<U*>(p.get())->r);
+          stack.push_back(&static_cast<U*>(p.get())->l);
         } else {
           elements.push_back(p);
         }
-      };
-      collect(this->l);
-      collect(this->r);
-      auto aggregated = std::make_shared<V>(this->val, elements);
-      return aggregated;
+      }
+      collected = std::make_shared<V>(this->val, elements);
+      return collected;
     }
 };
 
@@ -517,9 +681,22 @@ struct SumExpr : Expr<T>
 {
   DECLARE_NAME(SumExpr);
 
+  static constexpr auto Kind = ExprKind::Sum;
+
   std::vector<ExprPtr<T>> elements;
 
-  SumExpr(const T& val, const std::vector<ExprPtr<T>> &es): Expr<T>(val), elements(es) {}
+  SumExpr(const T& val, const std::vector<ExprPtr<T>> &es): Expr<T>(val), elements(es)
+  {
+    this->kind = Kind;
+    this->requires_grad = std::any_of(elements.begin(), elements.end(), [](const auto& x) { return x->requires_grad; });
+  }
+
+  /// Constant terms do not contribute to any derivative, so they are dropped altogether.
+  virtual void fold_step()
+  {
+    elements.erase(std::remove_if(elements.begin(), elements.end(), [](const auto& x) { return !x->requires_grad; }), elements.end());
+    this->requires_grad = !elements.empty();
+  }
 
   virtual void propagate_step() 
   {
@@ -528,6 +705,22 @@ struct SumExpr : Expr<T>
     }
   }
 
+  virtual void tangent_step()
+  {
+    this->dot = T(0.0);
+    for(const auto &x: elements) {
+      this->dot += x->dot;
+    }
+  }
+
+  virtual void propagate_tangent_step()
+  {
+    for(const auto &x: elements) {
+      x->grad += this->grad;
+      x->grad_dot += this->grad_dot;
+    }
+  }
+
   virtual void propagate(const T& wprime) 
   {
     for(auto x: elements) {
@@ -564,9 +757,24 @@ struct ProdExpr : Expr<T>
 {
   DECLARE_NAME(ProdExpr);
 
+  static constexpr auto Kind = ExprKind::Prod;
+
   std::vector<ExprPtr<T>> elements;
 
-  ProdExpr(const T& val, const std::vector<ExprPtr<T>> &es): Expr<T>(val), elements(es) {}
+  ProdExpr(const T& val, const std::vector<ExprPtr<T>> &es): Expr<T>(val), elements(es)
+  {
+    this->kind = Kind;
+    this->requires_grad = std::any_of(elements.begin(), elements.end(), [](const auto& x) { return x->requires_grad; });
+  }
+
+  virtual void fold_step()
+  {
+    this->requires_grad = false;
+    for(auto& x: elements) {
+      this->fold_child(x);
+      this->requires_grad = this->requires_grad || x->requires_grad;
+    }
+  }
 
   virtual void propagate_step() 
   {
@@ -579,6 +787,28 @@ struct ProdExpr : Expr<T>
     }
   }
 
+  virtual void tangent_step()
+  {
+    this->dot = T(0.0);
+    for (auto x: elements) {
+      this->dot += this->val / x->val * x->dot;
+    }
+  }
+
+  virtual void propagate_tangent_step()
+  {
+    // d2/dxi dxj = val / (xi * xj) for i != j
+    auto sum = T(0.0);
+    for (auto x: elements) {
+      sum += x->dot / x->val;
+    }
+    for (auto x: elements) {
+      const auto d = this->val / x->val;
+      x->grad += this->grad * d;
+      x->grad_dot += this->grad_dot * d + this->grad * d * (sum - x->dot / x->val);
+    }
+  }
+
   virtual void propagate(const T& wprime) 
   {
     auto prod = wprime;
@@ -623,11 +853,13 @@ struct AddExpr : BinaryExpr<T>
 {
     DECLARE_NAME(AddExpr);
 
+    static constexpr auto Kind = ExprKind::Add;
+
     // Using declarations for data members of base class
     using BinaryExpr<T>::l;
     using BinaryExpr<T>::r;
 
-    using BinaryExpr<T>::BinaryExpr;
+    AddExpr(const T& val, const ExprPtr<T>& l, const ExprPtr<T>& r) : BinaryExpr<T>(val, l, r) { this->kind = Kind; }
 
     virtual void propagate_step() 
     {
@@ -651,6 +883,11 @@ struct AddExpr : BinaryExpr<T>
     {
       return this->template collect_rewrite<AddExpr<T>, SumExpr<T>>();
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        return { T(1.0), T(1.0), T(0.0), T(0.0), T(0.0) };
+    }
 };
 
 template<typename T>
@@ -679,6 +916,11 @@ struct SubExpr : BinaryExpr<T>
         l->propagatex( wprime);
         r->propagatex(-wprime);
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        return { T(1.0), T(-1.0), T(0.0), T(0.0), T(0.0) };
+    }
 };
 
 template<typename T>
@@ -686,10 +928,13 @@ struct MulExpr : BinaryExpr<T>
 {
     DECLARE_NAME(MulExpr);
 
+    static constexpr auto Kind = ExprKind::Mul;
+
     // Using declarations for data members of base class
     using BinaryExpr<T>::l;
     using BinaryExpr<T>::r;
-    using BinaryExpr<T>::BinaryExpr;
+
+    MulExpr(const T& val, const ExprPtr<T>& l, const ExprPtr<T>& r) : BinaryExpr<T>(val, l, r) { this->kind = Kind; }
 
     virtual void propagate_step() 
     {
@@ -713,6 +958,11 @@ struct MulExpr : BinaryExpr<T>
     {
       return this->template collect_rewrite<MulExpr<T>, ProdExpr<T>>();
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        return { r->val, l->val, T(0.0), T(1.0), T(0.0) };
+    }
 };
 
 template<typename T>
@@ -747,6 +997,12 @@ struct DivExpr : BinaryExpr<T>
         l->propagatex(wprime * aux1);
         r->propagatex(wprime * aux2);
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        const auto aux = T(1.0) / r->val;
+        return { aux, -l->val * aux * aux, T(0.0), -aux * aux, T(2.0) * l->val * aux * aux * aux };
+    }
 };
 
 template<typename T>
@@ -772,6 +1028,11 @@ struct SinExpr : UnaryExpr<T>
     {
         x->propagatex(wprime * cos(x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { std::cos(x->val), -this->val };
+    }
 };
 
 template<typename T>
@@ -797,6 +1058,11 @@ struct CosExpr : UnaryExpr<T>
     {
         x->propagatex(-wprime * sin(x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { -std::sin(x->val), -this->val };
+    }
 };
 
 template<typename T>
@@ -825,6 +1091,12 @@ struct TanExpr : UnaryExpr<T>
         const auto aux = 1.0 / cos(x);
         x->propagatex(wprime * aux * aux);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 1.0 / std::cos(x->val);
+        return { aux * aux, 2.0 * this->val * aux * aux };
+    }
 };
 
 template<typename T>
@@ -850,6 +1122,11 @@ struct SinhExpr : UnaryExpr<T>
     {
         x->propagatex(wprime * cosh(x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { std::cosh(x->val), this->val };
+    }
 };
 
 template<typename T>
@@ -875,6 +1152,11 @@ struct CoshExpr : UnaryExpr<T>
     {
         x->propagatex(wprime * sinh(x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { std::sinh(x->val), this->val };
+    }
 };
 
 template<typename T>
@@ -903,6 +1185,12 @@ struct TanhExpr : UnaryExpr<T>
         const auto aux = 1.0 / cosh(x);
         x->propagatex(wprime * aux * aux);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 1.0 / std::cosh(x->val);
+        return { aux * aux, -2.0 * this->val * aux * aux };
+    }
 };
 
 template<typename T>
@@ -928,6 +1216,12 @@ struct ArcSinExpr : UnaryExpr<T>
     {
         x->propagatex(wprime / sqrt(1.0 - x * x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 1.0 / std::sqrt(1.0 - x->val * x->val);
+        return { aux, x->val * aux * aux * aux };
+    }
 };
 
 template<typename T>
@@ -953,6 +1247,12 @@ struct ArcCosExpr : UnaryExpr<T>
     {
         x->propagatex(-wprime / sqrt(1.0 - x * x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 1.0 / std::sqrt(1.0 - x->val * x->val);
+        return { -aux, -x->val * aux * aux * aux };
+    }
 };
 
 template<typename T>
@@ -978,6 +1278,12 @@ struct ArcTanExpr : UnaryExpr<T>
     {
         x->propagatex(wprime / (1.0 + x * x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 1.0 / (1.0 + x->val * x->val);
+        return { aux, -2.0 * x->val * aux * aux };
+    }
 };
 
 template<typename T>
@@ -1003,6 +1309,11 @@ struct ExpExpr : UnaryExpr<T>
     {
         x->propagatex(wprime * exp(x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { this->val, this->val };
+    }
 };
 
 template<typename T>
@@ -1029,6 +1340,12 @@ struct LogExpr : UnaryExpr<T>
     {
         x->propagatex(wprime / x);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = T(1.0) / x->val;
+        return { aux, -aux * aux };
+    }
 };
 
 template<typename T>
@@ -1056,6 +1373,12 @@ struct Log10Expr : UnaryExpr<T>
     {
         x->propagatex(wprime / (ln10 * x));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 1.0 / x->val;
+        return { aux / ln10, -aux * aux / ln10 };
+    }
 };
 
 template<typename T>
@@ -1095,6 +1418,13 @@ struct PowExpr : BinaryExpr<T>
         l->propagatex(aux * r);
         r->propagatex(aux * l * log(l));
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        const auto aux = this->val / l->val;
+        const auto logl = std::log(l->val);
+        return { aux * r->val, this->val * logl, aux * r->val * (r->val - 1.0) / l->val, aux * (1.0 + r->val * logl), this->val * logl * logl };
+    }
 };
 
 template<typename T>
@@ -1122,6 +1452,12 @@ struct PowConstantLeftExpr : BinaryExpr<T>
     {
         r->propagatex(wprime * pow(l, r) * log(l));
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        const auto logl = std::log(l->val);
+        return { T(0.0), this->val * logl, T(0.0), T(0.0), this->val * logl * logl };
+    }
 };
 
 template<typename T>
@@ -1149,6 +1485,12 @@ struct PowConstantRightExpr : BinaryExpr<T>
     {
         l->propagatex(wprime * pow(l, r - 1) * r);
     }
+
+    virtual std::array<T, 5> partials()
+    {
+        const auto aux = this->val / l->val;
+        return { aux * r->val, T(0.0), aux * r->val * (r->val - 1.0) / l->val, T(0.0), T(0.0) };
+    }
 };
 
 template<typename T>
@@ -1174,6 +1516,12 @@ struct SqrtExpr : UnaryExpr<T>
     {
         x->propagatex(wprime / (2.0 * sqrt(x)));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 0.5 / this->val;
+        return { aux, -0.5 * aux / x->val };
+    }
 };
 
 template<typename T>
@@ -1203,6 +1551,11 @@ struct AbsExpr : UnaryExpr<T>
         if(x->val < 0.0) x->propagatex(-wprime);
         else x->propagatex(wprime);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { x->val < 0.0 ? T(-1.0) : T(1.0), T(0.0) };
+    }
 };
 
 template<typename T>
@@ -1233,6 +1586,12 @@ struct ErfExpr : UnaryExpr<T>
         const auto aux = 2.0/sqrt_pi * exp(-x*x);
         x->propagatex(wprime * aux);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = 2.0/sqrt_pi * std::exp(-(x->val)*(x->val));
+        return { aux, -2.0 * x->val * aux };
+    }
 };
 
 template <typename T>
@@ -1262,6 +1621,12 @@ struct SigmoidExpr : UnaryExpr<T>
         auto aux = exp(x);
         x->propagatex(wprime * aux / (aux + T(1.0)) / (aux + T(1.0)));
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        const auto aux = this->val * (T(1.0) - this->val);
+        return { aux, aux * (T(1.0) - T(2.0) * this->val) };
+    }
 };
 
 template <typename T>
@@ -1290,23 +1655,636 @@ struct ReLUExpr : UnaryExpr<T>
         const auto aux = x->val >= 0.0 ? T(1.0) : T(0.0);
         x->propagatex(wprime * aux);
     }
+
+    virtual std::array<T, 2> partials()
+    {
+        return { x->val >= 0.0 ? T(1.0) : T(0.0), T(0.0) };
+    }
+};
+
+/// A segment of the expression graph whose internal nodes are not kept, but recomputed from its inputs when derivatives are propagated.
+/// Its outputs are represented by CheckpointOutputExpr nodes. See @ref checkpoint.
+template<typename T>
+struct CheckpointExpr : Expr<T>
+{
+    DECLARE_NAME(CheckpointExpr);
+
+    using Function = std::function<std::vector<Variable<T>>(const std::vector<Variable<T>>&)>;
+
+    /// The inputs of the segment.
+    std::vector<ExprPtr<T>> inputs;
+
+    /// The function that computes the outputs of the segment from its inputs.
+    Function fn;
+
+    /// The derivatives of the root expression node with respect to each output of the segment.
+    std::vector<T> grads;
+
+    CheckpointExpr(const std::vector<ExprPtr<T>>& inputs, const Function& fn, std::size_t noutputs)
+    : Expr<T>(T(0.0)), inputs(inputs), fn(fn), grads(noutputs)
+    {
+        this->requires_grad = std::any_of(inputs.begin(), inputs.end(), [](const auto& x) { return x->requires_grad; });
+    }
+
+    /// Recompute the outputs of the segment from the given inputs.
+    std::vector<Variable<T>> recompute(const std::vector<ExprPtr<T>>& xs)
+    {
+        return fn(std::vector<Variable<T>>(xs.begin(), xs.end()));
+    }
+
+    /// Recompute the segment on copies of its inputs, so that the local sweep stops there, and run the sweep from the accumulated output derivatives.
+    virtual void propagate_step()
+    {
+        std::vector<ExprPtr<T>> xs;
+        xs.reserve(inputs.size());
+        for(const auto& x: inputs) {
+            xs.push_back(std::make_shared<IndependentVariableExpr<T>>(x->val));
+            xs.back()->requires_grad = x->requires_grad;
+        }
+
+        auto outputs = recompute(xs);
+
+        std::vector<Expr<T>*> vec;
+        for(std::size_t i = 0; i < outputs.size(); ++i) {
+            outputs[i].expr->topology_sort(vec);
+        }
+        for(std::size_t i = 0; i < outputs.size(); ++i) {
+            outputs[i].expr->grad += grads[i];
+            grads[i] = T(0.0);
+        }
+        for(auto it = vec.rbegin(); it != vec.rend(); ++it) {
+            (*it)->propagate_step();
+        }
+
+        for(std::size_t i = 0; i < inputs.size(); ++i) {
+            inputs[i]->grad += xs[i]->grad;
+        }
+    }
+
+    // The segment itself is only reached through its outputs.
+    virtual void propagate(const T& wprime) {}
+
+    virtual void propagatex(const ExprPtr<T>& wprime) {}
+
+    virtual ExprPtr<T> rewrite()
+    {
+      if(this->rewritten) return nullptr;
+      this->rewritten = true;
+      for(auto& x: inputs) {
+        auto child = x->rewrite();
+        if(child) {
+          x = child;
+        }
+      }
+      return nullptr;
+    }
+
+    virtual void fold_step()
+    {
+      this->requires_grad = false;
+      for(auto& x: inputs) {
+        this->fold_child(x);
+        this->requires_grad = this->requires_grad || x->requires_grad;
+      }
+    }
+
+    virtual void print(int indent)
+    {
+      this->Expr<T>::print(indent);
+      for(const auto &x: inputs) {
+        x->print(indent + 2);
+      }
+    }
+
+    virtual void children_do(std::function<void(Expr<T>*)> fn)
+    {
+      for(const auto &x: inputs) {
+        fn(x.get());
+      }
+    }
+};
+
+/// The node in the expression tree representing an output of a checkpointed segment.
+template<typename T>
+struct CheckpointOutputExpr : UnaryExpr<T>
+{
+    DECLARE_NAME(CheckpointOutputExpr);
+    // Using declarations for data members of base class
+    using UnaryExpr<T>::x;
+
+    /// The index of this output in the segment.
+    std::size_t index;
+
+    CheckpointOutputExpr(const T& val, const ExprPtr<T>& x, std::size_t index) : UnaryExpr<T>(val, x), index(index) {}
+
+    CheckpointExpr<T>* segment() { return static_cast<CheckpointExpr<T>*>(x.get()); }
+
+    virtual void propagate_step()
+    {
+        segment()->grads[index] += this->grad;
+    }
+
+    /// Without a topological sweep every output recomputes the segment on its own.
+    virtual void propagate(const T& wprime)
+    {
+        segment()->recompute(segment()->inputs)[index].expr->propagate(wprime);
+    }
+
+    virtual void propagatex(const ExprPtr<T>& wprime)
+    {
+        segment()->recompute(segment()->inputs)[index].expr->propagatex(wprime);
+    }
+
+    // The segment must not be replaced by a constant, only its inputs.
+    virtual void fold_step()
+    {
+        this->requires_grad = x->requires_grad;
+    }
+
+    // Hessian-vector products are not supported across checkpointed segments.
+    virtual std::array<T, 2> partials()
+    {
+        assert(false && "Hessian-vector products across checkpointed segments are not supported.");
+        return { T(0.0), T(0.0) };
+    }
+};
+
+//------------------------------------------------------------------------------
+// STATEMENT-LEVEL EXPRESSION TEMPLATES
+//------------------------------------------------------------------------------
+/// Compile-time expressions over the leaves returned by @ref fuse. Every node keeps its value, so that
+/// assigning a statement to a Variable records one FusedExpr node with the local partial derivatives.
+namespace stmt {
+
+/// The I-th leaf of a statement.
+/// It refers to the expression of the fused Variable, which must outlive the statement (not the resulting node).
+template<typename T, std::size_t I>
+struct Leaf
+{
+    using value_type = T;
+    static constexpr std::size_t size = I + 1;
+
+    T val;
+    const ExprPtr<T>* expr;
+
+    template<std::size_t N> void collect(std::array<ExprPtr<T>, N>& xs) const { xs[I] = *expr; }
+    template<std::size_t N> void accumulate(const T& w, std::array<T, N>& d) const { d[I] += w; }
+    template<std::size_t N> ExprPtr<T> build(const std::array<ExprPtr<T>, N>& xs) const { return xs[I]; }
+};
+
+/// A number in a statement.
+template<typename T>
+struct Const
+{
+    using value_type = T;
+    static constexpr std::size_t size = 0;
+
+    T val;
+
+    template<std::size_t N> void collect(std::array<ExprPtr<T>, N>&) const {}
+    template<std::size_t N> void accumulate(const T&, std::array<T, N>&) const {}
+    template<std::size_t N> ExprPtr<T> build(const std::array<ExprPtr<T>, N>&) const { return constant<T>(val); }
+};
+
+template<typename Op, typename X>
+struct Unary
+{
+    using T = typename X::value_type;
+    using value_type = T;
+    static constexpr std::size_t size = X::size;
+
+    X x;
+    T val;
+
+    explicit Unary(const X& x) : x(x), val(Op::eval(x.val)) {}
+
+    template<std::size_t N> void collect(std::array<ExprPtr<T>, N>& xs) const { x.collect(xs); }
+    template<std::size_t N> void accumulate(const T& w, std::array<T, N>& d) const { x.accumulate(w * Op::d(x.val, val), d); }
+    template<std::size_t N> ExprPtr<T> build(const std::array<ExprPtr<T>, N>& xs) const { return Op::build(x.build(xs)); }
+};
+
+template<typename Op, typename L, typename R>
+struct Binary
+{
+    using T = typename L::value_type;
+    using value_type = T;
+    static constexpr std::size_t size = std::max(L::size, R::size);
+
+    L l;
+    R r;
+    T val;
+
+    Binary(const L& l, const R& r) : l(l), r(r), val(Op::eval(l.val, r.val)) {}
+
+    template<std::size_t N> void collect(std::array<ExprPtr<T>, N>& xs) const { l.collect(xs); r.collect(xs); }
+
+    template<std::size_t N> void accumulate(const T& w, std::array<T, N>& d) const
+    {
+        const auto [dl, dr] = Op::d(l.val, r.val, val);
+        l.accumulate(w * dl, d);
+        r.accumulate(w * dr, d);
+    }
+
+    template<std::size_t N> ExprPtr<T> build(const std::array<ExprPtr<T>, N>& xs) const { return Op::build(l.build(xs), r.build(xs)); }
+};
+
+template<typename E> struct isStatement { constexpr static bool value = false; };
+template<typename T, std::size_t I> struct isStatement<Leaf<T, I>> { constexpr static bool value = true; };
+template<typename T> struct isStatement<Const<T>> { constexpr static bool value = true; };
+template<typename Op, typename X> struct isStatement<Unary<Op, X>> { constexpr static bool value = true; };
+template<typename Op, typename L, typename R> struct isStatement<Binary<Op, L, R>> { constexpr static bool value = true; };
+
+// The operators: value, derivative(s) given the operand value(s) and the result, and the ordinary expression node.
+struct AddOp
+{
+    template<typename T> static T eval(const T& l, const T& r) { return l + r; }
+    template<typename T> static std::array<T, 2> d(const T&, const T&, const T&) { return { T(1.0), T(1.0) }; }
+    template<typename T> static ExprPtr<T> build(const ExprPtr<T>& l, const ExprPtr<T>& r) { return l + r; }
+};
+
+struct SubOp
+{
+    template<typename T> static T eval(const T& l, const T& r) { return l - r; }
+    template<typename T> static std::array<T, 2> d(const T&, const T&, const T&) { return { T(1.0), T(-1.0) }; }
+    template<typename T> static ExprPtr<T> build(const ExprPtr<T>& l, const ExprPtr<T>& r) { return l - r; }
+};
+
+struct MulOp
+{
+    template<typename T> static T eval(const T& l, const T& r) { return l * r; }
+    template<typename T> static std::array<T, 2> d(const T& l, const T& r, const T&) { return { r, l }; }
+    template<typename T> static ExprPtr<T> build(const ExprPtr<T>& l, const ExprPtr<T>& r) { return l * r; }
+};
+
+struct DivOp
+{
+    template<typename T> static T eval(const T& l, const T& r) { return l / r; }
+    template<typename T> static std::array<T, 2> d(const T&, const T& r, const T& y) { const auto aux = T(1.0) / r; return { aux, -y * aux }; }
+    template<typename T> static ExprPtr<T> build(const ExprPtr<T>& l, const ExprPtr<T>& r) { return l / r; }
+};
+
+struct PowOp
+{
+    template<typename T> static T eval(const T& l, const T& r) { return std::pow(l, r); }
+    template<typename T> static std::array<T, 2> d(const T& l, const T& r, const T& y)
+    {
+        // As in PowExpr: no contribution from log(l) when l is zero
+        return { r * std::pow(l, r - T(1.0)), l == T(0.0) ? T(0.0) : y * std::log(l) };
+    }
+    template<typename T> static ExprPtr<T> build(const ExprPtr<T>& l, const ExprPtr<T>& r) { return pow(l, r); }
+};
+
+#define AUTODIFF_DEFINE_STATEMENT_UNARY_OP(Name, fn, value, deriv) \
+    struct Name \
+    { \
+        template<typename T> static T eval(const T& x) { return value; } \
+        template<typename T> static T d([[maybe_unused]] const T& x, [[maybe_unused]] const T& y) { return deriv; } \
+        template<typename T> static ExprPtr<T> build(const ExprPtr<T>& x) { return fn(x); } \
+    };
+
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(NegOp, -, -x, T(-1.0))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(SinOp, sin, std::sin(x), std::cos(x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(CosOp, cos, std::cos(x), -std::sin(x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(TanOp, tan, std::tan(x), T(1.0) + y * y)
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(ArcSinOp, asin, std::asin(x), T(1.0) / std::sqrt(T(1.0) - x * x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(ArcCosOp, acos, std::acos(x), T(-1.0) / std::sqrt(T(1.0) - x * x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(ArcTanOp, atan, std::atan(x), T(1.0) / (T(1.0) + x * x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(SinhOp, sinh, std::sinh(x), std::cosh(x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(CoshOp, cosh, std::cosh(x), std::sinh(x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(TanhOp, tanh, std::tanh(x), T(1.0) - y * y)
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(ExpOp, exp, std::exp(x), y)
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(LogOp, log, std::log(x), T(1.0) / x)
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(Log10Op, log10, std::log10(x), T(1.0) / (T(2.3025850929940456840179914546843) * x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(SqrtOp, sqrt, std::sqrt(x), T(0.5) / y)
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(AbsOp, abs, std::abs(x), x < T(0.0) ? T(-1.0) : T(1.0))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(ErfOp, erf, std::erf(x), T(1.1283791670955125738961589031215) * std::exp(-x * x))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(SigmoidOp, sigmoid, T(1.0) / (T(1.0) + std::exp(-x)), y * (T(1.0) - y))
+AUTODIFF_DEFINE_STATEMENT_UNARY_OP(ReLUOp, relu, x >= T(0.0) ? x : T(0.0), x >= T(0.0) ? T(1.0) : T(0.0))
+
+#undef AUTODIFF_DEFINE_STATEMENT_UNARY_OP
+
+template<typename E>
+constexpr bool isStatementV = isStatement<E>::value;
+
+template<typename E, EnableIf<isStatementV<E>>...> auto operator+(const E& x) { return x; }
+template<typename E, EnableIf<isStatementV<E>>...> auto operator-(const E& x) { return Unary<NegOp, E>(x); }
+
+#define AUTODIFF_DEFINE_STATEMENT_BINARY_OP(op, Op) \
+    template<typename L, typename R, EnableIf<isStatementV<L> && isStatementV<R>>...> \
+    auto op(const L& l, const R& r) { return Binary<Op, L, R>(l, r); } \
+    template<typename L, typename U, EnableIf<isStatementV<L> && isArithmetic<U>>...> \
+    auto op(const L& l, const U& r) { using T = typename L::value_type; return Binary<Op, L, Const<T>>(l, Const<T>{ T(r) }); } \
+    template<typename U, typename R, EnableIf<isArithmetic<U> && isStatementV<R>>...> \
+    auto op(const U& l, const R& r) { using T = typename R::value_type; return Binary<Op, Const<T>, R>(Const<T>{ T(l) }, r); }
+
+AUTODIFF_DEFINE_STATEMENT_BINARY_OP(operator+, AddOp)
+AUTODIFF_DEFINE_STATEMENT_BINARY_OP(operator-, SubOp)
+AUTODIFF_DEFINE_STATEMENT_BINARY_OP(operator*, MulOp)
+AUTODIFF_DEFINE_STATEMENT_BINARY_OP(operator/, DivOp)
+AUTODIFF_DEFINE_STATEMENT_BINARY_OP(pow, PowOp)
+
+#undef AUTODIFF_DEFINE_STATEMENT_BINARY_OP
+
+#define AUTODIFF_DEFINE_STATEMENT_FUNCTION(fn, Op) \
+    template<typename E, EnableIf<isStatementV<E>>...> auto fn(const E& x) { return Unary<Op, E>(x); }
+
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(sin, SinOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(cos, CosOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(tan, TanOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(asin, ArcSinOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(acos, ArcCosOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(atan, ArcTanOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(sinh, SinhOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(cosh, CoshOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(tanh, TanhOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(exp, ExpOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(log, LogOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(log10, Log10Op)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(sqrt, SqrtOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(abs, AbsOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(erf, ErfOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(sigmoid, SigmoidOp)
+AUTODIFF_DEFINE_STATEMENT_FUNCTION(relu, ReLUOp)
+
+#undef AUTODIFF_DEFINE_STATEMENT_FUNCTION
+
+template<typename T, typename... Vars, std::size_t... Is>
+auto leaves(std::index_sequence<Is...>, const Vars&... xs)
+{
+    return std::make_tuple(Leaf<T, Is>{ xs.expr->val, &xs.expr }...);
+}
+
+} // namespace stmt
+
+template<typename E>
+constexpr bool isStatement = stmt::isStatement<E>::value;
+
+/// A statement-level expression such as `a*b + sin(c)`, built from the leaves returned by @ref fuse, recorded as a single node.
+/// The partial derivatives of the statement with respect to its leaves are computed once, when the node is created,
+/// so the adjoint sweep only scales and scatters them, instead of visiting one heap node per operator.
+template<typename T, typename E>
+struct FusedExpr : Expr<T>
+{
+    DECLARE_NAME(FusedExpr);
+
+    static constexpr auto N = E::size;
+
+    /// The statement; only its structure and constants are used again (to rebuild an ordinary graph in @ref propagatex).
+    E stmt;
+
+    /// The leaves of the statement.
+    std::array<ExprPtr<T>, N> children;
+
+    /// The partial derivatives of the statement with respect to its leaves.
+    std::array<T, N> partials;
+
+    explicit FusedExpr(const E& stmt) : Expr<T>(stmt.val), stmt(stmt)
+    {
+        stmt.collect(children);
+        for(auto& x: children) {
+            if(!x) x = constant<T>(0.0); // a leaf that is not used in the statement
+        }
+        partials.fill(T(0.0));
+        stmt.accumulate(T(1.0), partials);
+        this->requires_grad = std::any_of(children.begin(), children.end(), [](const auto& x) { return x->requires_grad; });
+    }
+
+    virtual void propagate_step()
+    {
+        for(std::size_t i = 0; i < N; ++i) {
+            children[i]->grad += this->grad * partials[i];
+        }
+    }
+
+    virtual void propagate(const T& wprime)
+    {
+        for(std::size_t i = 0; i < N; ++i) {
+            children[i]->propagate(wprime * partials[i]);
+        }
+    }
+
+    /// Derivatives as expressions need the operators of the statement, so an ordinary graph is rebuilt on the leaves.
+    virtual void propagatex(const ExprPtr<T>& wprime)
+    {
+        stmt.build(children)->propagatex(wprime);
+    }
+
+    virtual void tangent_step()
+    {
+        this->dot = T(0.0);
+        for(std::size_t i = 0; i < N; ++i) {
+            this->dot += partials[i] * children[i]->dot;
+        }
+    }
+
+    /// The second derivatives are obtained from a local Hessian-vector sweep over an ordinary graph rebuilt on copies of the leaves.
+    virtual void propagate_tangent_step()
+    {
+        std::array<ExprPtr<T>, N> xs;
+        for(std::size_t i = 0; i < N; ++i) {
+            xs[i] = std::make_shared<IndependentVariableExpr<T>>(children[i]->val);
+            xs[i]->dot = children[i]->dot;
+        }
+
+        auto y = stmt.build(xs);
+
+        std::vector<Expr<T>*> vec;
+        y->topology_sort(vec);
+        for(auto x: vec) {
+            x->tangent_step();
+        }
+        y->grad += this->grad;
+        y->grad_dot += this->grad_dot;
+        for(auto it = vec.rbegin(); it != vec.rend(); ++it) {
+            (*it)->propagate_tangent_step();
+        }
+
+        for(std::size_t i = 0; i < N; ++i) {
+            children[i]->grad += xs[i]->grad;
+            children[i]->grad_dot += xs[i]->grad_dot;
+        }
+    }
+
+    virtual ExprPtr<T> rewrite()
+    {
+      if(this->rewritten) return nullptr;
+      this->rewritten = true;
+      for(auto& x: children) {
+        auto child = x->rewrite();
+        if(child) {
+          x = child;
+        }
+      }
+      return nullptr;
+    }
+
+    virtual void fold_step()
+    {
+      this->requires_grad = false;
+      for(auto& x: children) {
+        this->fold_child(x);
+        this->requires_grad = this->requires_grad || x->requires_grad;
+      }
+    }
+
+    virtual void print(int indent)
+    {
+      this->Expr<T>::print(indent);
+      for(const auto &x: children) {
+        x->print(indent + 2);
+      }
+    }
+
+    virtual void children_do(std::function<void(Expr<T>*)> fn)
+    {
+      for(const auto &x: children) {
+        fn(x.get());
+      }
+    }
 };
 
+/// Return the leaves of a statement over the given variables, e.g. `auto [a, b, c] = fuse(x, y, z); Variable<T> w = a*b + sin(c);`.
+/// The whole statement is recorded as a single FusedExpr node. The variables must outlive the statement.
+template<typename T, typename... Vars>
+auto fuse(const Variable<T>& x, const Vars&... xs)
+{
+    return stmt::leaves<T>(std::index_sequence_for<Variable<T>, Vars...>{}, x, xs...);
+}
+
+/// Record a statement as a single FusedExpr node, or only a constant with its value if none of its leaves require a gradient.
+template<typename E, EnableIf<isStatement<E>>...>
+auto fused(const E& e) -> ExprPtr<typename E::value_type>
+{
+    using T = typename E::value_type;
+    auto node = std::make_shared<FusedExpr<T, E>>(e);
+    if(!node->requires_grad) return constant<T>(node->val);
+    return node;
+}
+
 //------------------------------------------------------------------------------
 // CONVENIENT FUNCTIONS
 //------------------------------------------------------------------------------
 template<typename T> ExprPtr<T> constant(const T& val) { return std::make_shared<ConstantExpr<T>>(val); }
 
+/// Create an expression node of type E, or only a constant with its value if none of its operands require a gradient.
+template<template<typename> typename E, typename T, typename... Args>
+ExprPtr<T> make_expr(const T& val, const Args&... args)
+{
+    if(!(args->requires_grad || ...)) return constant<T>(val);
+    return std::make_shared<E<T>>(val, args...);
+}
+
+/// Fold the subtrees of a topologically sorted expression graph that no longer require a gradient (e.g. after freezing variables) into constants.
+/// The folded nodes are removed from @p vec, so that an adjoint sweep over it only visits nodes that contribute to a derivative.
+template<typename T>
+void fold_constants(std::vector<Expr<T>*>& vec)
+{
+    // A node is only released once all of its parents have been folded, and these come after it in topological order.
+    std::size_t n = 0;
+    for(auto x: vec) {
+      x->fold_step();
+      if(x->requires_grad) vec[n++] = x;
+    }
+    vec.resize(n);
+}
+
+/// The size and shape of an expression graph, see @ref tape_stats.
+struct TapeStats
+{
+    /// The number of nodes of each type, by name().
+    std::map<std::string, std::size_t> counts;
+
+    /// The number of nodes.
+    std::size_t nodes = 0;
+
+    /// The memory held by the nodes, without their child containers and allocator overhead.
+    std::size_t bytes = 0;
+
+    /// The number of nodes on the longest path from the root to a leaf.
+    std::size_t depth = 0;
+
+    /// The largest number of children of a node.
+    std::size_t max_fan_in = 0;
+
+    /// The largest number of parents of a node.
+    std::size_t max_fan_out = 0;
+};
+
+/// Return the statistics of the whole expression graph of y, including the nodes that do not require a gradient.
+/// The graph is walked without recursion and without touching the colors used by @ref Expr::topology_sort.
+template<typename T>
+TapeStats tape_stats(const ExprPtr<T>& y)
+{
+    TapeStats stats;
+
+    // The depth of every visited node, zero while it is still on the stack
+    std::unordered_map<Expr<T>*, std::size_t> depth;
+    std::unordered_map<Expr<T>*, std::size_t> parents;
+
+    struct Frame { Expr<T>* e; std::size_t begin, next; };
+    std::vector<Frame> stack;
+    std::vector<Expr<T>*> children;
+
+    auto push = [&](Expr<T>* e) {
+        const auto begin = children.size();
+        e->children_do([&](auto x){ children.push_back(x); ++parents[x]; });
+        stats.max_fan_in = std::max(stats.max_fan_in, children.size() - begin);
+        stack.push_back({ e, begin, begin });
+        depth[e] = 0;
+    };
+
+    push(y.get());
+    while(!stack.empty()) {
+        auto& top = stack.back();
+        if(top.next < children.size()) {
+            auto x = children[top.next++];
+            if(!depth.count(x)) push(x);
+            continue;
+        }
+        auto e = top.e;
+        std::size_t d = 0;
+        for(auto i = top.begin; i < children.size(); ++i)
+            d = std::max(d, depth[children[i]]);
+        depth[e] = d + 1;
+
+        ++stats.counts[e->name()];
+        ++stats.nodes;
+        stats.bytes += e->bytes();
+
+        children.resize(top.begin);
+        stack.pop_back();
+    }
+
+    stats.depth = depth[y.get()];
+    for(const auto& [e, n] : parents)
+        stats.max_fan_out = std::max(stats.max_fan_out, n);
+
+    return stats;
+}
+
+/// Output a TapeStats object to the output stream, as `key= value` pairs on one line.
+inline std::ostream& operator<<(std::ostream& out, const TapeStats& stats)
+{
+    out << "nodes= " << stats.nodes
+        << " bytes= " << stats.bytes
+        << " depth= " << stats.depth
+        << " fanin= " << stats.max_fan_in
+        << " fanout= " << stats.max_fan_out;
+    for(const auto& [name, n] : stats.counts)
+        out << " " << name << "= " << n;
+    return out;
+}
+
 //------------------------------------------------------------------------------
 // ARITHMETIC OPERATORS
 //------------------------------------------------------------------------------
 template<typename T> ExprPtr<T> operator+(const ExprPtr<T>& r) { return r; }
-template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& r) { return std::make_shared<NegativeExpr<T>>(-r->val, r); }
+template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& r) { return make_expr<NegativeExpr, T>(-r->val, r); }
 
-template<typename T> ExprPtr<T> operator+(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<AddExpr<T>>(l->val + r->val, l, r); }
-template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<SubExpr<T>>(l->val - r->val, l, r); }
-template<typename T> ExprPtr<T> operator*(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<MulExpr<T>>(l->val * r->val, l, r); }
-template<typename T> ExprPtr<T> operator/(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<DivExpr<T>>(l->val / r->val, l, r); }
+template<typename T> ExprPtr<T> operator+(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_expr<AddExpr, T>(l->val + r->val, l, r); }
+template<typename T> ExprPtr<T> operator-(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_expr<SubExpr, T>(l->val - r->val, l, r); }
+template<typename T> ExprPtr<T> operator*(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_expr<MulExpr, T>(l->val * r->val, l, r); }
+template<typename T> ExprPtr<T> operator/(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_expr<DivExpr, T>(l->val / r->val, l, r); }
 
 template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> operator+(const U& l, const ExprPtr<T>& r) { return constant<T>(l) + r; }
 template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> operator-(const U& l, const ExprPtr<T>& r) { return constant<T>(l) - r; }
@@ -1322,55 +2300,55 @@ template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> operat
 //------------------------------------------------------------------------------
 // TRIGONOMETRIC FUNCTIONS
 //------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> sin(const ExprPtr<T>& x) { return std::make_shared<SinExpr<T>>(std::sin(x->val), x); }
-template<typename T> ExprPtr<T> cos(const ExprPtr<T>& x) { return std::make_shared<CosExpr<T>>(std::cos(x->val), x); }
-template<typename T> ExprPtr<T> tan(const ExprPtr<T>& x) { return std::make_shared<TanExpr<T>>(std::tan(x->val), x); }
-template<typename T> ExprPtr<T> asin(const ExprPtr<T>& x) { return std::make_shared<ArcSinExpr<T>>(std::asin(x->val), x); }
-template<typename T> ExprPtr<T> acos(const ExprPtr<T>& x) { return std::make_shared<ArcCosExpr<T>>(std::acos(x->val), x); }
-template<typename T> ExprPtr<T> atan(const ExprPtr<T>& x) { return std::make_shared<ArcTanExpr<T>>(std::atan(x->val), x); }
+template<typename T> ExprPtr<T> sin(const ExprPtr<T>& x) { return make_expr<SinExpr, T>(std::sin(x->val), x); }
+template<typename T> ExprPtr<T> cos(const ExprPtr<T>& x) { return make_expr<CosExpr, T>(std::cos(x->val), x); }
+template<typename T> ExprPtr<T> tan(const ExprPtr<T>& x) { return make_expr<TanExpr, T>(std::tan(x->val), x); }
+template<typename T> ExprPtr<T> asin(const ExprPtr<T>& x) { return make_expr<ArcSinExpr, T>(std::asin(x->val), x); }
+template<typename T> ExprPtr<T> acos(const ExprPtr<T>& x) { return make_expr<ArcCosExpr, T>(std::acos(x->val), x); }
+template<typename T> ExprPtr<T> atan(const ExprPtr<T>& x) { return make_expr<ArcTanExpr, T>(std::atan(x->val), x); }
 
 
 //------------------------------------------------------------------------------
 // HYPERBOLIC FUNCTIONS
 //------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> sinh(const ExprPtr<T>& x) { return std::make_shared<SinhExpr<T>>(std::sinh(x->val), x); }
-template<typename T> ExprPtr<T> cosh(const ExprPtr<T>& x) { return std::make_shared<CoshExpr<T>>(std::cosh(x->val), x); }
-template<typename T> ExprPtr<T> tanh(const ExprPtr<T>& x) { return std::make_shared<TanhExpr<T>>(std::tanh(x->val), x); }
+template<typename T> ExprPtr<T> sinh(const ExprPtr<T>& x) { return make_expr<SinhExpr, T>(std::sinh(x->val), x); }
+template<typename T> ExprPtr<T> cosh(const ExprPtr<T>& x) { return make_expr<CoshExpr, T>(std::cosh(x->val), x); }
+template<typename T> ExprPtr<T> tanh(const ExprPtr<T>& x) { return make_expr<TanhExpr, T>(std::tanh(x->val), x); }
 
 
 //------------------------------------------------------------------------------
 // EXPONENTIAL AND LOGARITHMIC FUNCTIONS
 //------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> exp(const ExprPtr<T>& x) { return std::make_shared<ExpExpr<T>>(std::exp(x->val), x); }
-template<typename T> ExprPtr<T> log(const ExprPtr<T>& x) { return std::make_shared<LogExpr<T>>(std::log(x->val), x); }
-template<typename T> ExprPtr<T> log10(const ExprPtr<T>& x) { return std::make_shared<Log10Expr<T>>(std::log10(x->val), x); }
+template<typename T> ExprPtr<T> exp(const ExprPtr<T>& x) { return make_expr<ExpExpr, T>(std::exp(x->val), x); }
+template<typename T> ExprPtr<T> log(const ExprPtr<T>& x) { return make_expr<LogExpr, T>(std::log(x->val), x); }
+template<typename T> ExprPtr<T> log10(const ExprPtr<T>& x) { return make_expr<Log10Expr, T>(std::log10(x->val), x); }
 
 
 //------------------------------------------------------------------------------
 // POWER FUNCTIONS
 //------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> sqrt(const ExprPtr<T>& x) { return std::make_shared<SqrtExpr<T>>(std::sqrt(x->val), x); }
-template<typename T> ExprPtr<T> pow(const ExprPtr<T>& l, const ExprPtr<T>& r) { return std::make_shared<PowExpr<T>>(std::pow(l->val, r->val), l, r); }
-template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> pow(const U& l, const ExprPtr<T>& r) { return std::make_shared<PowConstantLeftExpr<T>>(std::pow(l, r->val), constant<T>(l), r); }
-template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> pow(const ExprPtr<T>& l, const U& r) { return std::make_shared<PowConstantRightExpr<T>>(std::pow(l->val, r), l, constant<T>(r)); }
+template<typename T> ExprPtr<T> sqrt(const ExprPtr<T>& x) { return make_expr<SqrtExpr, T>(std::sqrt(x->val), x); }
+template<typename T> ExprPtr<T> pow(const ExprPtr<T>& l, const ExprPtr<T>& r) { return make_expr<PowExpr, T>(std::pow(l->val, r->val), l, r); }
+template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> pow(const U& l, const ExprPtr<T>& r) { return make_expr<PowConstantLeftExpr, T>(std::pow(l, r->val), constant<T>(l), r); }
+template<typename T, typename U, EnableIf<isArithmetic<U>>...> ExprPtr<T> pow(const ExprPtr<T>& l, const U& r) { return make_expr<PowConstantRightExpr, T>(std::pow(l->val, r), l, constant<T>(r)); }
 
 
 //------------------------------------------------------------------------------
 // OTHER FUNCTIONS
 //------------------------------------------------------------------------------
-template<typename T> ExprPtr<T> abs(const ExprPtr<T>& x) { return std::make_shared<AbsExpr<T>>(std::abs(x->val), x); }
+template<typename T> ExprPtr<T> abs(const ExprPtr<T>& x) { return make_expr<AbsExpr, T>(std::abs(x->val), x); }
 template<typename T> ExprPtr<T> abs2(const ExprPtr<T>& x) { return x * x; }
 template<typename T> ExprPtr<T> conj(const ExprPtr<T>& x) { return x; }
 template<typename T> ExprPtr<T> real(const ExprPtr<T>& x) { return x; }
 template<typename T> ExprPtr<T> imag(const ExprPtr<T>& x) { return constant<T>(0.0); }
-template<typename T> ExprPtr<T> erf(const ExprPtr<T>& x) { return std::make_shared<ErfExpr<T>>(std::erf(x->val), x); }
+template<typename T> ExprPtr<T> erf(const ExprPtr<T>& x) { return make_expr<ErfExpr, T>(std::erf(x->val), x); }
 
 
 //------------------------------------------------------------------------------
 // ACTIVATION FUNCTIONS
 //------------------------------------------------------------------------------
-template <typename T> ExprPtr<T> sigmoid(const ExprPtr<T>& x) { return std::make_shared<SigmoidExpr<T>>(T(1.0) / (T(1.0) + std::exp(-x->val)), x); }
-template <typename T> ExprPtr<T> relu(const ExprPtr<T>& x) { return std::make_shared<ReLUExpr<T>>(x->val >= T(0.0) ? x->val : T(0.0), x); }
+template <typename T> ExprPtr<T> sigmoid(const ExprPtr<T>& x) { return make_expr<SigmoidExpr, T>(T(1.0) / (T(1.0) + std::exp(-x->val)), x); }
+template <typename T> ExprPtr<T> relu(const ExprPtr<T>& x) { return make_expr<ReLUExpr, T>(x->val >= T(0.0) ? x->val : T(0.0), x); }
 
 //------------------------------------------------------------------------------
 // COMPARISON OPERATORS
@@ -1423,12 +2401,23 @@ struct Variable
     /// Construct a Variable object with given expression
     Variable(const ExprPtr<T>& expr) : expr(expr) {}
 
+    /// Construct a Variable object with given statement over the leaves returned by @ref fuse, recorded as a single node
+    template<typename E, EnableIf<isStatement<E>>...>
+    Variable(const E& e) : expr(fused(e)) {}
+
     /// Return the derivative value stored in this variable.
     auto grad() const { return expr->grad; }
 
     /// Return the derivative expression stored in this variable.
     auto gradx() const { return expr->gradx; }
 
+    /// Return true if derivatives with respect to this variable are computed.
+    bool requires_grad() const { return expr->requires_grad; }
+
+    /// Set whether derivatives with respect to this variable are computed (e.g. to freeze a parameter).
+    /// Expressions built from it afterwards inherit the setting.
+    void requires_grad(bool value) { expr->requires_grad = value; }
+
     /// Reeet the derivative value stored in this variable to zero.
     auto seed() { expr->grad = 0; }
 
@@ -1454,6 +2443,10 @@ struct Variable
     /// Assign an expression to this variable.
     auto operator=(const ExprPtr<T>& x) -> Variable& { *this = Variable(x); return *this; }
 
+    /// Assign a statement to this variable, recorded as a single node.
+    template<typename E, EnableIf<isStatement<E>>...>
+    auto operator=(const E& e) -> Variable& { *this = Variable(fused(e)); return *this; }
+
 	// Assignment operators
     Variable& operator+=(const ExprPtr<T>& x) { *this = Variable(expr + x); return *this; }
     Variable& operator-=(const ExprPtr<T>& x) { *this = Variable(expr - x); return *this; }
@@ -1593,11 +2586,34 @@ template <typename T> ExprPtr<T> sum(const std::vector<Variable<T>> &xs) {
   exps.reserve(xs.size());
   for(const auto &x: xs) {
     acc += x.expr->val;
-    exps.push_back(x.expr);
+    if(x.expr->requires_grad) {
+      exps.push_back(x.expr);
+    }
   }
+  if(exps.empty()) return constant<T>(acc);
   return std::make_shared<SumExpr<T>>(acc, exps);
 }
 
+//------------------------------------------------------------------------------
+// GRADIENT CHECKPOINTING
+//------------------------------------------------------------------------------
+/// Evaluate @p fn on @p inputs without keeping the expression nodes it creates; they are recomputed from the inputs when derivatives are propagated.
+/// This trades computation for memory in deep expression graphs. All expressions the outputs of @p fn depend on must be passed in @p inputs.
+template<typename T, typename Function>
+std::vector<Variable<T>> checkpoint(const std::vector<Variable<T>>& inputs, const Function& fn)
+{
+    const std::vector<Variable<T>> outputs = fn(inputs);
+    auto segment = std::make_shared<CheckpointExpr<T>>(std::vector<ExprPtr<T>>(inputs.begin(), inputs.end()), fn, outputs.size());
+
+    std::vector<Variable<T>> ret;
+    ret.reserve(outputs.size());
+    for(std::size_t i = 0; i < outputs.size(); ++i) {
+      if(segment->requires_grad) ret.push_back(ExprPtr<T>(std::make_shared<CheckpointOutputExpr<T>>(outputs[i].expr->val, segment, i)));
+      else ret.push_back(constant<T>(outputs[i].expr->val));
+    }
+    return ret;
+}
+
 
 /// Return the value of a scalar.
 template<typename U, EnableIf<isArithmetic<U>>...>
@@ -1669,12 +2685,37 @@ auto seedx(const Wrt<Vars...>& wrt)
     });
 }
 
+/// Propagate the derivative of the root expression y with respect to itself to all nodes of its expression graph.
+/// The graph is sorted once and every node is visited once in reverse topological order, so shared subexpressions
+/// cost no more than a single use. The derivatives of the independent variables are accumulated, as in
+/// @ref Expr::propagate, while those of the intermediate nodes are only used during the sweep and left at zero.
+template<typename T>
+void backward(const ExprPtr<T>& y)
+{
+    std::vector<Expr<T>*> vec;
+    y->topology_sort(vec);
+
+    auto reset = [&]() {
+        for(auto e : vec)
+            if(e->kind != ExprKind::Independent) e->grad = T(0.0);
+    };
+
+    reset();
+    y->grad += T(1.0);
+    for(auto it = vec.rbegin(); it != vec.rend(); ++it)
+        (*it)->propagate_step();
+    reset();
+
+    for(auto e : vec)
+        e->color = 0;
+}
+
 /// Return the derivatives of a dependent variable y with respect given independent variables.
 template<typename T, typename... Vars>
 auto derivatives(const Variable<T>& y, const Wrt<Vars...>& wrt)
 {
     seed(wrt);
-    y.expr->propagate(1.0);
+    backward(y.expr);
 
     constexpr static auto N = sizeof...(Vars);
     std::array<T, N> values;
@@ -1747,6 +2788,7 @@ using reverse::wrt;
 using reverse::derivatives;
 using reverse::Variable;
 using reverse::val;
+using reverse::fuse;
 
 using var = Variable<double>;
 
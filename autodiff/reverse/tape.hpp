@@ -0,0 +1,369 @@
+//                  _  _
+//  _   _|_ _  _|o_|__|_
+// (_||_||_(_)(_|| |  |
+//
+// automatic differentiation made easier in C++
+// https://github.com/autodiff/autodiff
+//
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+//
+// Copyright (c) 2018-2020 Allan Leal
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+// C++ includes
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// autodiff includes
+#include <autodiff/reverse/eigen.hpp>
+
+//------------------------------------------------------------------------------
+// LINEARIZED EXPRESSION GRAPHS FOR MULTI-OUTPUT REVERSE MODE
+//------------------------------------------------------------------------------
+namespace autodiff {
+namespace reverse {
+
+template<typename W> struct Adjoints;
+
+/// The expression graph of one or more outputs, sorted once and flattened into the local partial derivatives of every
+/// node with respect to its children. The nodes are in topological order (children first) and their children and
+/// partials are stored contiguously, so adjoint sweeps run over plain arrays, may be repeated for any number of seeds,
+/// and may run concurrently with private @ref Adjoints. The tape is a snapshot: it is not updated when the graph changes.
+template<typename T>
+struct Tape
+{
+    /// The nodes of the graph in topological order.
+    std::vector<Expr<T>*> nodes;
+
+    /// The children of node k are `children[offsets[k]]` to `children[offsets[k + 1] - 1]`.
+    std::vector<std::size_t> offsets;
+
+    /// The indices of the children of every node.
+    std::vector<std::size_t> children;
+
+    /// The partial derivatives of every node with respect to its children.
+    std::vector<T> partials;
+
+    /// The index of every node of the graph.
+    std::unordered_map<const Expr<T>*, std::size_t> indices;
+
+    /// Sort and linearize the graph of the given outputs. Nodes that do not require gradients are left out.
+    explicit Tape(const std::vector<ExprPtr<T>>& roots)
+    {
+        for(const auto& y : roots)
+            if(y->requires_grad) y->topology_sort(nodes);
+        for(auto e : nodes)
+            e->color = 0;
+
+        indices.reserve(nodes.size());
+        for(std::size_t k = 0; k < nodes.size(); ++k)
+            indices[nodes[k]] = k;
+
+        // The partials are read off a unit seed propagated by each node to its (distinct) children
+        offsets.reserve(nodes.size() + 1);
+        offsets.push_back(0);
+        std::vector<Expr<T>*> xs;
+        for(auto e : nodes)
+        {
+            assert(!dynamic_cast<CheckpointExpr<T>*>(e) && "Jacobians across checkpointed segments are not supported.");
+
+            xs.clear();
+            e->children_do([&](auto x) {
+                if(indices.count(x) && std::find(xs.begin(), xs.end(), x) == xs.end())
+                    xs.push_back(x);
+            });
+
+            const auto grad = e->grad;
+            std::vector<T> saved;
+            for(auto x : xs) {
+                saved.push_back(x->grad);
+                x->grad = T(0.0);
+            }
+
+            e->grad = T(1.0);
+            e->propagate_step();
+            e->grad = grad;
+
+            for(std::size_t i = 0; i < xs.size(); ++i) {
+                children.push_back(indices[xs[i]]);
+                partials.push_back(xs[i]->grad);
+                xs[i]->grad = saved[i];
+            }
+            offsets.push_back(children.size());
+        }
+    }
+
+    /// Return the index of the given node, or the number of nodes if it is not on the tape.
+    std::size_t index(const Expr<T>* e) const
+    {
+        const auto it = indices.find(e);
+        return it == indices.end() ? nodes.size() : it->second;
+    }
+
+    /// Propagate the adjoints of node *top* and all nodes below it to their children.
+    template<typename W>
+    void sweep(std::size_t top, Adjoints<W>& a) const
+    {
+        for(auto k = top + 1; k-- > 0;)
+        {
+            if(!a.active[k]) continue;
+            for(auto i = offsets[k]; i < offsets[k + 1]; ++i)
+                a.add(children[i], a.w[k] * partials[i]);
+        }
+    }
+};
+
+/// The adjoints of all nodes of a tape, either scalars or fixed-width arrays that carry several seeds through one sweep.
+/// Only the nodes reached by a sweep are marked active, visited and reset afterwards.
+template<typename W>
+struct Adjoints
+{
+    /// The adjoint of every node, plus a last one, always zero, for variables that are not on the tape.
+    std::vector<W, Eigen::aligned_allocator<W>> w;
+
+    /// Whether the adjoint of every node is nonzero.
+    std::vector<char> active;
+
+    /// The nodes with nonzero adjoints.
+    std::vector<std::size_t> touched;
+
+    /// The zero adjoint.
+    W zero;
+
+    Adjoints(std::size_t size, const W& zero) : w(size + 1, zero), active(size + 1, 0), zero(zero) {}
+
+    /// Add *value* to the adjoint of node k.
+    template<typename V>
+    void add(std::size_t k, const V& value)
+    {
+        if(!active[k]) {
+            active[k] = 1;
+            touched.push_back(k);
+        }
+        w[k] += value;
+    }
+
+    /// Reset the adjoints of the nodes reached since the last reset.
+    void reset()
+    {
+        for(auto k : touched) {
+            w[k] = zero;
+            active[k] = 0;
+        }
+        touched.clear();
+    }
+};
+
+namespace detail {
+
+/// The number of seeds carried through one reverse sweep by @ref jacobian and @ref vjp.
+constexpr auto AdjointWidth = 8;
+
+template<typename T>
+using AdjointArray = Eigen::Array<T, AdjointWidth, 1>;
+
+/// Run *task(a, c)* for every chunk c in [0, count) on *nthreads* threads (0 for all hardware threads),
+/// each with private adjoints *a* for all nodes of *tape*, which the task must reset.
+template<typename T, typename Task>
+void runSweeps(const Tape<T>& tape, std::size_t count, std::size_t nthreads, const Task& task)
+{
+    if(count == 0) return;
+    if(nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::min(nthreads, count);
+
+    std::atomic<std::size_t> next(0);
+    auto worker = [&]() {
+        Adjoints<AdjointArray<T>> a(tape.nodes.size(), AdjointArray<T>::Constant(T(0.0)));
+        for(auto c = next++; c < count; c = next++)
+            task(a, c);
+    };
+
+    if(nthreads == 1) return worker();
+
+    std::vector<std::thread> threads;
+    for(std::size_t t = 0; t < nthreads; ++t)
+        threads.emplace_back(worker);
+    for(auto& thread : threads)
+        thread.join();
+}
+
+/// Return the tape of variables y and the indices on it of variables y and x.
+template<typename T, typename Y, typename X>
+auto linearize(const Eigen::DenseBase<Y>& y, const Eigen::DenseBase<X>& x)
+{
+    std::vector<ExprPtr<T>> roots(y.size());
+    for(auto i = 0; i < y.size(); ++i)
+        roots[i] = y[i].expr;
+
+    Tape<T> tape(roots);
+
+    std::vector<std::size_t> rows(y.size());
+    for(auto i = 0; i < y.size(); ++i)
+        rows[i] = tape.index(roots[i].get());
+
+    std::vector<std::size_t> cols(x.size());
+    for(auto j = 0; j < x.size(); ++j)
+        cols[j] = tape.index(x[j].expr.get());
+
+    return std::make_tuple(std::move(tape), std::move(rows), std::move(cols));
+}
+
+template<typename X>
+using VariableType = std::decay_t<decltype(std::declval<typename X::Scalar>().expr->val)>;
+
+template<typename Y, typename X>
+constexpr void checkVariables()
+{
+    using ScalarX = typename X::Scalar;
+    static_assert(isVariable<ScalarX>, "Argument x is not a vector with Variable<T> (aka var) objects.");
+
+    using ScalarY = typename Y::Scalar;
+    static_assert(std::is_same_v<ScalarX, ScalarY>, "Arguments y and x do not have the same Variable<T> type.");
+}
+
+} // namespace detail
+
+/// Return the Jacobian matrix of variables Y with respect to variables x.
+/// The shared expression graph of Y is sorted once and each adjoint sweep over it computes a chunk of rows, on
+/// *nthreads* threads (0 for all hardware threads). The derivatives stored in the variables are not changed.
+template<typename Y, typename X>
+auto jacobian(const Eigen::DenseBase<Y>& y, Eigen::DenseBase<X>& x, std::size_t nthreads = 1)
+{
+    detail::checkVariables<Y, X>();
+
+    using T = detail::VariableType<X>;
+    using U = VariableValueType<T>;
+
+    constexpr auto RowsY = Y::RowsAtCompileTime;
+    constexpr auto MaxRowsY = Y::MaxRowsAtCompileTime;
+    constexpr auto RowsX = X::RowsAtCompileTime;
+    constexpr auto MaxRowsX = X::MaxRowsAtCompileTime;
+    constexpr auto W = detail::AdjointWidth;
+
+    const auto m = y.size();
+    const auto n = x.size();
+
+    const auto linear = detail::linearize<T>(y, x);
+    const auto& tape = std::get<0>(linear);
+    const auto& rows = std::get<1>(linear);
+    const auto& cols = std::get<2>(linear);
+
+    Mat<U, RowsY, RowsX, MaxRowsY, MaxRowsX> J(m, n);
+    J.setZero();
+
+    detail::runSweeps(tape, (m + W - 1) / W, nthreads, [&](auto& a, std::size_t c) {
+        const auto begin = c * W;
+        const auto width = std::min<std::size_t>(W, m - begin);
+
+        std::size_t top = 0;
+        for(std::size_t l = 0; l < width; ++l) {
+            const auto k = rows[begin + l];
+            if(k == tape.nodes.size()) continue; // y[i] does not depend on any variable
+            auto seed = a.zero;
+            seed[l] = T(1.0);
+            a.add(k, seed);
+            top = std::max(top, k);
+        }
+        if(a.touched.empty()) return;
+
+        tape.sweep(top, a);
+
+        for(std::size_t l = 0; l < width; ++l)
+            for(auto j = 0; j < n; ++j)
+                J(begin + l, j) = val(a.w[cols[j]][l]);
+
+        a.reset();
+    });
+
+    return J;
+}
+
+/// Return the products of the transposed Jacobian matrix of variables Y with respect to variables x and the columns of V.
+/// Each adjoint sweep over the shared expression graph of Y carries a chunk of columns of V, on *nthreads* threads
+/// (0 for all hardware threads). The derivatives stored in the variables are not changed.
+template<typename Y, typename X, typename V>
+auto vjp(const Eigen::DenseBase<Y>& y, Eigen::DenseBase<X>& x, const Eigen::DenseBase<V>& v, std::size_t nthreads = 1)
+{
+    detail::checkVariables<Y, X>();
+
+    using T = detail::VariableType<X>;
+    using U = VariableValueType<T>;
+
+    constexpr auto RowsX = X::RowsAtCompileTime;
+    constexpr auto MaxRowsX = X::MaxRowsAtCompileTime;
+    constexpr auto ColsV = V::ColsAtCompileTime;
+    constexpr auto MaxColsV = V::MaxColsAtCompileTime;
+    constexpr auto W = detail::AdjointWidth;
+
+    const auto m = y.size();
+    const auto n = x.size();
+    const auto p = v.cols();
+    assert(v.rows() == m);
+
+    const auto linear = detail::linearize<T>(y, x);
+    const auto& tape = std::get<0>(linear);
+    const auto& rows = std::get<1>(linear);
+    const auto& cols = std::get<2>(linear);
+
+    Mat<U, RowsX, ColsV, MaxRowsX, MaxColsV> G(n, p);
+    G.setZero();
+
+    detail::runSweeps(tape, (p + W - 1) / W, nthreads, [&](auto& a, std::size_t c) {
+        const auto begin = c * W;
+        const auto width = std::min<std::size_t>(W, p - begin);
+
+        std::size_t top = 0;
+        for(auto i = 0; i < m; ++i) {
+            const auto k = rows[i];
+            if(k == tape.nodes.size()) continue;
+            auto seed = a.zero;
+            for(std::size_t l = 0; l < width; ++l)
+                seed[l] = v(i, begin + l);
+            a.add(k, seed);
+            top = std::max(top, k);
+        }
+        if(a.touched.empty()) return;
+
+        tape.sweep(top, a);
+
+        for(auto j = 0; j < n; ++j)
+            for(std::size_t l = 0; l < width; ++l)
+                G(j, begin + l) = val(a.w[cols[j]][l]);
+
+        a.reset();
+    });
+
+    return G;
+}
+
+} // namespace reverse
+
+using reverse::jacobian;
+using reverse::vjp;
+
+} // namespace autodiff
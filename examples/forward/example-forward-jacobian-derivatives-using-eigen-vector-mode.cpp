@@ -0,0 +1,31 @@
+// C++ includes
+#include <iostream>
+using namespace std;
+
+// Eigen includes
+#include <Eigen/Core>
+using namespace Eigen;
+
+// autodiff include
+#include <autodiff/forward.hpp>
+#include <autodiff/forward/eigen.hpp>
+using namespace autodiff;
+
+// The vector function for which the Jacobian is needed
+VectorXdual8 f(const VectorXdual8& x)
+{
+    return x * x.sum();
+}
+
+int main()
+{
+    VectorXdual8 x(10);  // the input vector x with 10 variables, each carrying 8 tangent directions
+    x << 1, 2, 3, 4, 5, 6, 7, 8, 9, 10;
+
+    VectorXdual8 F;  // the output vector F = f(x) evaluated together with Jacobian matrix below
+
+    MatrixXd J = jacobian(f, wrt(x), at(x), F);  // evaluate F and dF/dx with 2 evaluations of f instead of 10
+
+    cout << "F = \n" << F << endl;  // print the evaluated output vector F
+    cout << "J = \n" << J << endl;  // print the evaluated Jacobian matrix dF/dx
+}
@@ -0,0 +1,27 @@
+// C++ includes
+#include <iostream>
+using namespace std;
+
+// autodiff include
+#include <autodiff/forward.hpp>
+#include <autodiff/forward/taylor.hpp>
+using namespace autodiff;
+
+// Define a truncated Taylor series type holding derivatives up to 5th order.
+using taylor5 = Taylor<5>;
+
+// The single-variable function for which derivatives are needed
+taylor5 f(taylor5 x)
+{
+    return exp(sin(x)) * log(1 + x*x) / sqrt(x);
+}
+
+int main()
+{
+    taylor5 x = 2.0;  // the input variable x
+
+    auto d = derivatives(f, wrt(x), at(x));  // evaluate u and its derivatives up to 5th order in one pass
+
+    for(auto k = 0; k <= 5; ++k)
+        cout << "d" << k << "u/dx" << k << " = " << d[k] << endl;  // print the evaluated k-th derivative
+}
@@ -0,0 +1,398 @@
+#pragma once
+#include "nn.hpp"
+#include "optim.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// Checkpoint file format, version 1 (little endian):
+/// - checkpoint_header_t at offset 0, followed by the layer shapes (rows, cols as int32 pairs);
+/// - the parameter values at params_offset, packed by checkpoint_codec<T>;
+/// - the optimizer state as doubles at optim_offset.
+/// the two tensors start on page boundaries so that a mapped file can be read in place.
+/// the checksum is the FNV-1a hash of the whole file, taken with the checksum field zeroed.
+
+constexpr char c_checkpoint_magic[8] = {'Q', 'N', 'U', 'M', 'C', 'K', 'P', 'T'};
+constexpr uint32_t c_checkpoint_version = 1;
+constexpr uint64_t c_checkpoint_align = 4096;
+
+struct checkpoint_header_t {
+  char     magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  // number type: kind, bytes per packed value, and the type parameters (see checkpoint_codec)
+  uint32_t kind;
+  uint32_t value_bytes;
+  int32_t  type_params[4];
+  uint32_t stochastic;
+  uint32_t nshapes;
+  // training position
+  int32_t  epoch;
+  int32_t  reserved;
+  int64_t  step;
+  // tensors
+  uint64_t nparams;
+  uint64_t params_offset;
+  uint64_t optim_count;
+  uint64_t optim_offset;
+  char     optim_name[32];
+  uint64_t file_size;
+  uint64_t checksum;
+};
+
+static_assert(std::is_standard_layout<checkpoint_header_t>::value && std::is_trivially_copyable<checkpoint_header_t>::value,
+              "the checkpoint header is written as raw bytes");
+
+/// how the values of a number type are stored: float and double as is,
+/// qspace_number_t as its backing integer followed by the growth flag,
+/// and flexfloat as the double it holds.
+template<typename T> struct checkpoint_codec {
+  static_assert(is_std_float<T>::value, "no checkpoint encoding for this number type");
+  static constexpr uint32_t kind = std::is_same<T, float>::value ? 1 : 2;
+  static constexpr uint32_t bytes = sizeof(T);
+  static constexpr bool stochastic = false;
+  static void params(int32_t* p) { p[0] = p[1] = p[2] = p[3] = 0; }
+  static void encode(const T& x, char* out) { std::memcpy(out, &x, sizeof(T)); }
+  static T decode(const char* in) { T x; std::memcpy(&x, in, sizeof(T)); return x; }
+};
+
+template<typename Ts, int E, int D, bool G, typename R>
+struct checkpoint_codec<qnum::qspace_number_t<Ts, E, D, G, R>> {
+  using T = qnum::qspace_number_t<Ts, E, D, G, R>;
+  static constexpr uint32_t kind = 3;
+  static constexpr uint32_t bytes = sizeof(Ts) + 1;
+  static constexpr bool stochastic = std::is_same<R, qnum::round_stochastic>::value;
+  static void params(int32_t* p) { p[0] = 8 * sizeof(Ts); p[1] = E; p[2] = D; p[3] = G; }
+  static void encode(const T& x, char* out) {
+    std::memcpy(out, &x.val, sizeof(Ts));
+    out[sizeof(Ts)] = x.growth;
+  }
+  static T decode(const char* in) {
+    T x;
+    std::memcpy(&x.val, in, sizeof(Ts));
+    x.growth = in[sizeof(Ts)] != 0;
+    return x;
+  }
+};
+
+template<uint_fast8_t e, uint_fast8_t f, typename R>
+struct checkpoint_codec<flex::flexfloat<e, f, R>> {
+  using T = flex::flexfloat<e, f, R>;
+  static constexpr uint32_t kind = 4;
+  static constexpr uint32_t bytes = sizeof(double);
+  static constexpr bool stochastic = std::is_same<R, qnum::round_stochastic>::value;
+  static void params(int32_t* p) { p[0] = e; p[1] = f; p[2] = p[3] = 0; }
+  static void encode(const T& x, char* out) { double v = x.getValue(); std::memcpy(out, &v, sizeof(v)); }
+  static T decode(const char* in) { double v; std::memcpy(&v, in, sizeof(v)); return T(v); }
+};
+
+inline std::string checkpoint_type_name(const checkpoint_header_t& h) {
+  const int32_t* p = h.type_params;
+  switch (h.kind) {
+  case 1: return "f32";
+  case 2: return "f64";
+  case 3: return "q" + std::to_string(p[0]) + " E=" + std::to_string(p[1]) + " D=" + std::to_string(p[2]) + " G=" + std::to_string(p[3]);
+  case 4: return "flexfloat<" + std::to_string(p[0]) + "," + std::to_string(p[1]) + ">";
+  default: return "unknown";
+  }
+}
+
+inline uint64_t fnv1a(const char* data, size_t size, uint64_t h = 0xcbf29ce484222325ull) {
+  for (size_t i = 0; i < size; ++i) {
+    h ^= static_cast<unsigned char>(data[i]);
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+inline uint64_t checkpoint_checksum(const char* data, size_t size) {
+  const size_t at = offsetof(checkpoint_header_t, checksum);
+  const uint64_t zero = 0;
+  uint64_t h = fnv1a(data, at);
+  h = fnv1a(reinterpret_cast<const char*>(&zero), sizeof(zero), h);
+  return fnv1a(data + at + sizeof(zero), size - at - sizeof(zero), h);
+}
+
+inline uint64_t checkpoint_align_up(uint64_t x) {
+  return (x + c_checkpoint_align - 1) / c_checkpoint_align * c_checkpoint_align;
+}
+
+/// the training position stored in a checkpoint.
+struct checkpoint_info_t {
+  int epoch = 0;
+  int64_t step = 0;
+};
+
+/// lay out the parameters, shapes and optimizer state (if any) of a network as a checkpoint file image.
+/// the checksum is left to seal_checkpoint, so that it can be computed off the training thread.
+template<typename T>
+std::vector<char> serialize_checkpoint(const nn_t<T>& net, const optim_t<T>* optim, int epoch, int64_t step) {
+  using codec = checkpoint_codec<T>;
+  const auto& block = *net.param_block;
+  std::vector<double> state;
+  std::string optim_name;
+  if (optim != nullptr) {
+    state = optim->state();
+    optim_name = optim->name();
+  }
+
+  checkpoint_header_t h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, c_checkpoint_magic, sizeof(h.magic));
+  h.version = c_checkpoint_version;
+  h.header_size = sizeof(h);
+  h.kind = codec::kind;
+  h.value_bytes = codec::bytes;
+  codec::params(h.type_params);
+  h.stochastic = codec::stochastic;
+  h.nshapes = net.param_shapes.size();
+  h.epoch = epoch;
+  h.step = step;
+  h.nparams = block.size();
+  h.params_offset = checkpoint_align_up(sizeof(h) + h.nshapes * 2 * sizeof(int32_t));
+  h.optim_count = state.size();
+  h.optim_offset = checkpoint_align_up(h.params_offset + h.nparams * h.value_bytes);
+  std::strncpy(h.optim_name, optim_name.c_str(), sizeof(h.optim_name) - 1);
+  h.file_size = h.optim_offset + h.optim_count * sizeof(double);
+
+  std::vector<char> buf(h.file_size, 0);
+  char* shapes = buf.data() + sizeof(h);
+  for (auto& s : net.param_shapes) {
+    int32_t rc[2] = {s.first, s.second};
+    std::memcpy(shapes, rc, sizeof(rc));
+    shapes += sizeof(rc);
+  }
+  char* values = buf.data() + h.params_offset;
+  for (auto& x : block) {
+    codec::encode(x.val, values);
+    values += codec::bytes;
+  }
+  if (!state.empty()) {
+    std::memcpy(buf.data() + h.optim_offset, state.data(), state.size() * sizeof(double));
+  }
+  std::memcpy(buf.data(), &h, sizeof(h));
+  return buf;
+}
+
+inline void seal_checkpoint(std::vector<char>& buf) {
+  uint64_t checksum = checkpoint_checksum(buf.data(), buf.size());
+  std::memcpy(buf.data() + offsetof(checkpoint_header_t, checksum), &checksum, sizeof(checksum));
+}
+
+/// write a sealed checkpoint image to name.tmp, fsync it and rename it over name,
+/// so that a crash leaves either the old file or the complete new one.
+inline bool write_checkpoint_file(const std::string& name, const std::vector<char>& buf) {
+  std::string tmp = name + ".tmp";
+  FILE* fp = fopen(tmp.c_str(), "wb");
+  if (fp == nullptr) {
+    std::cout << "[DEBUG] cannot write checkpoint " << name << std::endl;
+    return false;
+  }
+  bool ok = fwrite(buf.data(), buf.size(), 1, fp) == 1;
+  ok = fflush(fp) == 0 && ok;
+  ok = fsync(fileno(fp)) == 0 && ok;
+  ok = fclose(fp) == 0 && ok;
+  ok = ok && std::rename(tmp.c_str(), name.c_str()) == 0;
+  if (!ok) {
+    std::cout << "[DEBUG] failed to write checkpoint " << name << std::endl;
+    std::remove(tmp.c_str());
+  }
+  return ok;
+}
+
+template<typename T>
+bool save_checkpoint(const char* name, const nn_t<T>& net, const optim_t<T>* optim, int epoch, int64_t step) {
+  auto buf = serialize_checkpoint(net, optim, epoch, step);
+  seal_checkpoint(buf);
+  return write_checkpoint_file(name, buf);
+}
+
+/// write-behind checkpointing: save() takes the snapshot into a staging buffer on the calling thread
+/// and returns; a background thread seals and writes it. at most one snapshot waits behind the one
+/// being written, a newer one replaces it. of the files written, the last `keep` are kept (0 keeps all).
+struct checkpointer_t {
+  checkpointer_t(int keep = 0) : keep(keep), writer([this]() { run(); }) {}
+
+  ~checkpointer_t() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+  }
+
+  template<typename T>
+  void save(const std::string& name, const nn_t<T>& net, const optim_t<T>* optim, int epoch, int64_t step) {
+    auto buf = serialize_checkpoint(net, optim, epoch, step);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (has_pending) {
+        std::cout << "[DEBUG] checkpoint " << pending_name << " dropped, writer behind" << std::endl;
+      }
+      pending_name = name;
+      pending.swap(buf);
+      has_pending = true;
+    }
+    wake.notify_all();
+  }
+
+  /// block until every snapshot taken so far is on disk.
+  void flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]() { return !has_pending && !writing; });
+  }
+
+private:
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      wake.wait(lock, [this]() { return has_pending || stopping; });
+      if (!has_pending) break;
+      std::string name;
+      std::vector<char> buf;
+      name.swap(pending_name);
+      buf.swap(pending);
+      has_pending = false;
+      writing = true;
+      lock.unlock();
+
+      seal_checkpoint(buf);
+      bool ok = write_checkpoint_file(name, buf);
+      if (ok) {
+        written.push_back(name);
+        while (keep > 0 && static_cast<int>(written.size()) > keep) {
+          std::remove(written.front().c_str());
+          written.pop_front();
+        }
+      }
+
+      lock.lock();
+      writing = false;
+      idle.notify_all();
+    }
+  }
+
+  int keep;
+  std::deque<std::string> written;
+  std::mutex mutex;
+  std::condition_variable wake, idle;
+  std::string pending_name;
+  std::vector<char> pending;
+  bool has_pending = false;
+  bool writing = false;
+  bool stopping = false;
+  std::thread writer;
+};
+
+/// load a checkpoint into a network and, if given, an optimizer. the file is mapped and the values are
+/// decoded from the mapping into param_block. files without a header are read in the legacy format when
+/// their size matches. returns false, with a message, if the file does not fit the network.
+template<typename T>
+bool load_checkpoint(const char* name, nn_t<T>& net, optim_t<T>* optim = nullptr, checkpoint_info_t* info = nullptr) {
+  using codec = checkpoint_codec<T>;
+  auto& block = *net.param_block;
+
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) {
+    std::cout << "[DEBUG] cannot open checkpoint " << name << std::endl;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    std::cout << "[DEBUG] empty checkpoint " << name << std::endl;
+    return false;
+  }
+  const size_t size = st.st_size;
+
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    std::cout << "[DEBUG] cannot map checkpoint " << name << std::endl;
+    return false;
+  }
+  madvise(map, size, MADV_SEQUENTIAL);
+  const char* data = static_cast<const char*>(map);
+
+  auto fail = [&](const std::string& why) {
+    std::cout << "[DEBUG] bad checkpoint " << name << ": " << why << std::endl;
+    munmap(map, size);
+    return false;
+  };
+
+  checkpoint_header_t h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(&h, data, std::min(size, sizeof(h)));
+  if (size < sizeof(h) || std::memcmp(h.magic, c_checkpoint_magic, sizeof(h.magic)) != 0) {
+    munmap(map, size);
+    if (size == block.size() * sizeof(T)) {
+      std::cout << "[DEBUG] legacy checkpoint without header" << std::endl;
+      net.load(name);
+      return true;
+    }
+    std::cout << "[DEBUG] bad checkpoint " << name << ": neither a checkpoint nor a legacy dump of this network" << std::endl;
+    return false;
+  }
+  if (h.version > c_checkpoint_version) return fail("version " + std::to_string(h.version));
+  if (h.file_size != size) return fail("truncated");
+  if (h.checksum != checkpoint_checksum(data, size)) return fail("checksum mismatch");
+  if (h.header_size < sizeof(h) || h.header_size + h.nshapes * 2 * sizeof(int32_t) > h.params_offset ||
+      h.params_offset + h.nparams * h.value_bytes > h.optim_offset || h.optim_offset + h.optim_count * sizeof(double) > size) {
+    return fail("inconsistent layout");
+  }
+
+  checkpoint_header_t expect{};
+  expect.kind = codec::kind;
+  expect.value_bytes = codec::bytes;
+  codec::params(expect.type_params);
+  if (h.kind != expect.kind || h.value_bytes != expect.value_bytes ||
+      std::memcmp(h.type_params, expect.type_params, sizeof(h.type_params)) != 0) {
+    return fail("number type " + checkpoint_type_name(h) + ", expected " + checkpoint_type_name(expect));
+  }
+  if (h.nparams != block.size() || h.nshapes != net.param_shapes.size()) {
+    return fail(std::to_string(h.nparams) + " parameters in " + std::to_string(h.nshapes) + " tensors");
+  }
+  const char* shapes = data + h.header_size;
+  for (auto& s : net.param_shapes) {
+    int32_t rc[2];
+    std::memcpy(rc, shapes, sizeof(rc));
+    shapes += sizeof(rc);
+    if (rc[0] != s.first || rc[1] != s.second) {
+      return fail("layer shape " + std::to_string(rc[0]) + "x" + std::to_string(rc[1]));
+    }
+  }
+
+  const char* values = data + h.params_offset;
+  for (auto& x : block) {
+    x.val = codec::decode(values);
+    values += codec::bytes;
+  }
+
+  if (optim != nullptr && h.optim_count > 0) {
+    std::vector<double> state(h.optim_count);
+    std::memcpy(state.data(), data + h.optim_offset, h.optim_count * sizeof(double));
+    std::string saved(h.optim_name, strnlen(h.optim_name, sizeof(h.optim_name)));
+    if (saved != optim->name() || !optim->load_state(state)) {
+      std::cout << "[DEBUG] optimizer state of " << saved << " not restored into " << optim->name() << std::endl;
+    }
+  }
+  if (info != nullptr) {
+    info->epoch = h.epoch;
+    info->step = h.step;
+  }
+  munmap(map, size);
+  return true;
+}
@@ -14,6 +14,9 @@ struct cnn_t : public nn_t<T> {
   ndarray_t<T> b1, b2;
   mat Wf1, Wf2;
 
+  /// recompute the convolution layers during backward instead of keeping their nodes alive.
+  bool recompute = false;
+
   cnn_t(int c, int h, int w, int nclass)
     : nchannel(c), width(w), height(h), nclass(nclass),
       b1(16, h, w) , b2(32, h/2, w/2)
@@ -28,21 +31,23 @@ struct cnn_t : public nn_t<T> {
     Wf2 = weight_init<T>(128, nclass, true);
     nn_t<T>::register_params(Wf1);
     nn_t<T>::register_params(Wf2);
+    nn_t<T>::pack_params();
   }
 
   virtual vec forward(const vec& x) {
     ndarray_t<T> x1(x, nchannel, height, width);
-    auto x2 = conv2d_layer(x1, W1, b1, act_relu);
-    auto x3 = maxpooling_2d(x2, 2, 2);
+    using qnum::stats::in_layer;
+    auto x2 = in_layer("conv1", [&]() { return recompute ? conv2d_layer_recompute(x1, W1, b1, act_relu) : conv2d_layer(x1, W1, b1, act_relu); });
+    auto x3 = in_layer("pool1", [&]() { return maxpooling_2d(x2, 2, 2); });
     // dropout(x3.v, 0.25);
-    auto x4 = conv2d_layer(x3, W2, b2, act_relu);
-    auto x6 = maxpooling_2d(x4, 2, 2);
+    auto x4 = in_layer("conv2", [&]() { return recompute ? conv2d_layer_recompute(x3, W2, b2, act_relu) : conv2d_layer(x3, W2, b2, act_relu); });
+    auto x6 = in_layer("pool2", [&]() { return maxpooling_2d(x4, 2, 2); });
     // dropout(x6.v, 0.25);
     auto x7 = withb(x6.v);
-    auto x8 = fc_layer(x7, Wf1, act_relu);
+    auto x8 = in_layer("fc1", [&]() { return fc_layer(x7, Wf1, act_relu); });
     // dropout(x8, 0.5);
     auto x9 = withb(x8);
-    auto x10 = fc_layer(x9, Wf2, act_identity);
+    auto x10 = in_layer("fc2", [&]() { return fc_layer(x9, Wf2, act_identity); });
     return x10;
   }
 };
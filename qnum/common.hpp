@@ -21,7 +21,7 @@ template<typename T> struct is_qnum {
   static constexpr bool value = false;
 };
 
-template<typename T, int E> struct is_qnum<qnum::qspace_number_t<T, E>> {
+template<typename T, int E, typename R> struct is_qnum<qnum::qspace_number_t<T, E, 0, true, R>> {
   static constexpr bool value = true;
 };
 
@@ -29,7 +29,7 @@ template<typename T> struct is_flexfloat {
   static constexpr bool value = false;
 };
 
-template<int E, int F> struct is_flexfloat<flex::flexfloat<E, F>> {
+template<int E, int F, typename R> struct is_flexfloat<flex::flexfloat<E, F, R>> {
   static constexpr bool value = true;
 };
 
@@ -130,7 +130,7 @@ VectorXtvar<T> withb(const VectorXtvar<T>& x) {
 
   const auto n = x.size();
   VectorXtvar<T> ret(n+1);
-  ret[0] = T(1.0);
+  ret[0] = autodiff::reverse::constant<T>(T(1.0));
   for (auto i = 0; i < n; ++i) {
     ret[i+1] = x[i];
   }
@@ -191,7 +191,7 @@ VectorXtvar<T> act_softmax(const VectorXtvar<T>& x) {
 template<typename T>
 autodiff::reverse::Variable<T> loss_l2(const VectorXtvar<T>& y1, const VectorXtvar<T>& y2) {
   const auto n = y1.size();
-  autodiff::reverse::Variable<T> sum = 0;
+  autodiff::reverse::Variable<T> sum = autodiff::reverse::constant(T(0.0));
   for (auto i = 0; i < n; ++i) {
     sum += (y1[i] - y2[i]) * (y1[i] - y2[i]);
   }
@@ -201,8 +201,8 @@ autodiff::reverse::Variable<T> loss_l2(const VectorXtvar<T>& y1, const VectorXtv
 template<typename T>
 autodiff::reverse::Variable<T> loss_mse(const VectorXtvar<T>& y1, const VectorXtvar<T>& y2) {
   const auto n = y1.size();
-  autodiff::reverse::Variable<T> norm = T(1.0 / n);
-  autodiff::reverse::Variable<T> sum = 0;
+  autodiff::reverse::Variable<T> norm = autodiff::reverse::constant(T(1.0 / n));
+  autodiff::reverse::Variable<T> sum = autodiff::reverse::constant(T(0.0));
   for (auto i = 0; i < n; ++i) {
     auto diff = y1[i] - y2[i];
     sum += diff * diff * norm;
@@ -240,8 +240,8 @@ autodiff::reverse::Variable<T> loss_crossent(const VectorXtvar<T>& y1, const Vec
 template<typename T>
 autodiff::reverse::Variable<T> loss_abs(const VectorXtvar<T>& y1, const VectorXtvar<T>& y2) {
   const auto n = y1.size();
-  autodiff::reverse::Variable<T> norm = T(1.0 / n);
-  autodiff::reverse::Variable<T> sum = 0;
+  autodiff::reverse::Variable<T> norm = autodiff::reverse::constant(T(1.0 / n));
+  autodiff::reverse::Variable<T> sum = autodiff::reverse::constant(T(0.0));
   for (auto i = 0; i < n; ++i) {
     sum += abs(y1[i] - y2[i]) * norm;
   }
@@ -312,6 +312,40 @@ ndarray_t<T> conv2d_layer(ndarray_t<T>&x, std::vector<ndarray_t<T>> W, ndarray_t
   return convout;
 }
 
+/// conv2d_layer that only keeps its inputs alive, and recomputes the convolution nodes during backward.
+template<typename T>
+ndarray_t<T> conv2d_layer_recompute(ndarray_t<T>&x, std::vector<ndarray_t<T>>& W, ndarray_t<T>& b, VectorXtvar<T>(f)(const VectorXtvar<T>&)) {
+  using var = autodiff::reverse::Variable<T>;
+  std::vector<var> inputs(x.v.data(), x.v.data() + x.v.size());
+  for(auto &k: W) {
+    inputs.insert(inputs.end(), k.v.data(), k.v.data() + k.v.size());
+  }
+  inputs.insert(inputs.end(), b.v.data(), b.v.data() + b.v.size());
+
+  const int c = x.c, h = x.h, w = x.w;
+  const int nout = W.size(), kc = W[0].c, kh = W[0].h, kw = W[0].w;
+  auto segment = [=](const std::vector<var>& in) {
+    auto p = in.data();
+    auto take = [&](int n) { VectorXtvar<T> v(n); for(int i = 0; i < n; ++i) v[i] = *p++; return v; };
+    ndarray_t<T> xx(take(c * h * w), c, h, w);
+    std::vector<ndarray_t<T>> WW;
+    WW.reserve(nout);
+    for(int k = 0; k < nout; ++k) {
+      WW.emplace_back(take(kc * kh * kw), kc, kh, kw);
+    }
+    ndarray_t<T> bb(take(nout * h * w), nout, h, w);
+    auto out = conv2d_layer(xx, WW, bb, f);
+    return std::vector<var>(out.v.data(), out.v.data() + out.v.size());
+  };
+
+  auto outputs = autodiff::reverse::checkpoint(inputs, segment);
+  VectorXtvar<T> v(outputs.size());
+  for(int i = 0; i < v.size(); ++i) {
+    v[i] = outputs[i];
+  }
+  return ndarray_t<T>(v, nout, h, w);
+}
+
 template<typename T>
 ndarray_t<T> maxpooling_2d(ndarray_t<T>& a, int sx, int sy) {
   ndarray_t<T> ret(a.c, a.h / sy, a.w / sx);
@@ -14,13 +14,13 @@ namespace Eigen
   using namespace autodiff;
   /// Traits specialization for qspace_number_t.
   /// See Eigen/src/Core/NumTraits.h for documentation.
-  template<typename T, int E> struct NumTraits<qspace_number_t<T, E>>
-    : GenericNumTraits<qspace_number_t<T, E>>
+  template<typename T, int E, typename R> struct NumTraits<qspace_number_t<T, E, 0, true, R>>
+    : GenericNumTraits<qspace_number_t<T, E, 0, true, R>>
   {
-    typedef qspace_number_t<T, E> Real;
-    typedef qspace_number_t<T, E> NonInteger;
-    typedef qspace_number_t<T, E> Nested;
-    typedef qspace_number_t<T, E> Literal;
+    typedef qspace_number_t<T, E, 0, true, R> Real;
+    typedef qspace_number_t<T, E, 0, true, R> NonInteger;
+    typedef qspace_number_t<T, E, 0, true, R> Nested;
+    typedef qspace_number_t<T, E, 0, true, R> Literal;
 
     enum {
       IsComplex = 0,
@@ -42,15 +42,15 @@ namespace Eigen
   namespace internal {
     /// Partial specialization for random implementation for qspace numbers.
     /// See MathFunctions.h L535
-    template<typename T, int E> struct random_impl<qspace_number_t<T, E>>
+    template<typename T, int E, typename R> struct random_impl<qspace_number_t<T, E, 0, true, R>>
       : random_default_impl
         <
-        qspace_number_t<T, E>,
-        NumTraits<qspace_number_t<T, E>>::IsComplex,
-        NumTraits<qspace_number_t<T, E>>::IsInteger
+        qspace_number_t<T, E, 0, true, R>,
+        NumTraits<qspace_number_t<T, E, 0, true, R>>::IsComplex,
+        NumTraits<qspace_number_t<T, E, 0, true, R>>::IsInteger
         > 
     {
-      typedef qspace_number_t<T, E> _Q;
+      typedef qspace_number_t<T, E, 0, true, R> _Q;
       static inline _Q run(const _Q& x, const _Q& y) {
         if (x > y) return x;
 
@@ -66,15 +66,15 @@ namespace Eigen
       }
     };
 
-    template<typename T, int E> struct random_impl<Variable<qspace_number_t<T, E>>>
+    template<typename T, int E, typename R> struct random_impl<Variable<qspace_number_t<T, E, 0, true, R>>>
       : random_default_impl
         <
-        Variable<qspace_number_t<T, E>>,
-        NumTraits<Variable<qspace_number_t<T, E>>>::IsComplex,
-        NumTraits<Variable<qspace_number_t<T, E>>>::IsInteger
+        Variable<qspace_number_t<T, E, 0, true, R>>,
+        NumTraits<Variable<qspace_number_t<T, E, 0, true, R>>>::IsComplex,
+        NumTraits<Variable<qspace_number_t<T, E, 0, true, R>>>::IsInteger
         > 
     {
-      typedef qspace_number_t<T, E> _Q;
+      typedef qspace_number_t<T, E, 0, true, R> _Q;
       static inline Variable<_Q> run(const Variable<_Q>& x, const Variable<_Q>& y) {
         return Variable<_Q>(random_impl<_Q>::run(x.expr->val, y.expr->val));
       }
@@ -86,13 +86,13 @@ namespace Eigen
 
   /// Traits specialization for flexfloat.
   /// See Eigen/src/Core/NumTraits.h for documentation.
-  template<uint8_t E, uint8_t F> struct NumTraits<flexfloat<E, F>>
+  template<uint8_t E, uint8_t F, typename R> struct NumTraits<flexfloat<E, F, R>>
     : NumTraits<double>
   {
-    typedef flexfloat<E, F> Real;
-    typedef flexfloat<E, F> NonInteger;
-    typedef flexfloat<E, F> Nested;
-    typedef flexfloat<E, F> Literal;
+    typedef flexfloat<E, F, R> Real;
+    typedef flexfloat<E, F, R> NonInteger;
+    typedef flexfloat<E, F, R> Nested;
+    typedef flexfloat<E, F, R> Literal;
 
     enum {
       RequireInitialization = 1,
@@ -116,15 +116,15 @@ namespace Eigen
   namespace internal {
     /// Partial specialization for random implementation for flexfloat.
     /// See MathFunctions.h L535
-    template<uint8_t E, uint8_t F> struct random_impl<flexfloat<E, F>>
+    template<uint8_t E, uint8_t F, typename R> struct random_impl<flexfloat<E, F, R>>
       : random_default_impl
         <
-        flexfloat<E, F>,
-        NumTraits<flexfloat<E, F>>::IsComplex,
-        NumTraits<flexfloat<E, F>>::IsInteger
+        flexfloat<E, F, R>,
+        NumTraits<flexfloat<E, F, R>>::IsComplex,
+        NumTraits<flexfloat<E, F, R>>::IsInteger
         > 
     {
-      typedef flexfloat<E, F> _Q;
+      typedef flexfloat<E, F, R> _Q;
       static inline _Q run(const _Q& x, const _Q& y) {
         if (x > y) return x;
         double rn = std::rand();
@@ -138,15 +138,15 @@ namespace Eigen
       }
     };
 
-    template<uint8_t E, uint8_t F> struct random_impl<Variable<flexfloat<E, F>>>
+    template<uint8_t E, uint8_t F, typename R> struct random_impl<Variable<flexfloat<E, F, R>>>
       : random_default_impl
         <
-        Variable<flexfloat<E, F>>,
-        NumTraits<Variable<flexfloat<E, F>>>::IsComplex,
-        NumTraits<Variable<flexfloat<E, F>>>::IsInteger
+        Variable<flexfloat<E, F, R>>,
+        NumTraits<Variable<flexfloat<E, F, R>>>::IsComplex,
+        NumTraits<Variable<flexfloat<E, F, R>>>::IsInteger
         > 
     {
-      typedef flexfloat<E, F> _Q;
+      typedef flexfloat<E, F, R> _Q;
       static inline Variable<_Q> run(const Variable<_Q>& x, const Variable<_Q>& y) {
         return Variable<_Q>(random_impl<_Q>::run(x.expr->val, y.expr->val));
       }
@@ -0,0 +1,128 @@
+#pragma once
+#include "nn.hpp"
+#include "optim.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <string>
+
+/// learning rate as a function of the number of updates applied: constant, step decay
+/// (times gamma every step_size updates) or cosine decay to zero over total updates,
+/// after a linear warmup over the first warmup updates.
+struct lr_schedule_t {
+  std::string kind = "constant";
+  double base = 0.01;
+  long long warmup = 0;
+  long long step_size = 1;
+  double gamma = 0.1;
+  long long total = 1;
+
+  double at(long long step) const {
+    if (step < warmup) {
+      return base * (step + 1) / warmup;
+    }
+    if (kind == "step") {
+      return base * std::pow(gamma, (step - warmup) / step_size);
+    } else if (kind == "cosine") {
+      double t = std::min(1.0, static_cast<double>(step - warmup) / std::max(1LL, total - warmup));
+      return 0.5 * base * (1.0 + std::cos(std::acos(-1.0) * t));
+    }
+    return base;
+  }
+};
+
+/// whether a loss or gradient can be used: finite, and for qnum not saturated.
+template<typename T>
+bool usable(const T& x) {
+  if constexpr(is_qnum<T>::value) {
+    return !x.saturated();
+  } else {
+    return std::isfinite(static_cast<double>(x));
+  }
+}
+
+/// the update half of a training step. the samples of a minibatch report their losses through
+/// check_loss before backward; an unusable loss, or one that alone puts the batch mean above
+/// max_loss, aborts the step, so that the backward passes not yet started are skipped and nothing
+/// is applied. check_batch does the same for the mean once all samples are in. update() then walks
+/// the gradients once for their global norm and for unusable values, clips them to clip_norm, and
+/// steps the optimizer with the scheduled learning rate.
+template<typename T>
+struct engine_t {
+  using param_t = typename nn_t<T>::param_t;
+
+  nn_t<T>& net;
+  optim_t<T>& optim;
+  lr_schedule_t schedule;
+  double clip_norm = 0.0;
+  double max_loss = 10.0;
+
+  /// updates applied, which drive the schedule
+  long long step = 0;
+  /// of the last update: the learning rate and the global gradient norm before clipping
+  double lr = 0.0;
+  double grad_norm = 0.0;
+
+  std::atomic<bool> aborted{false};
+  int nsamples = 1;
+
+  engine_t(nn_t<T>& net, optim_t<T>& optim) : net(net), optim(optim) {}
+
+  void begin_step(int batch_size) {
+    net.seed();
+    net.loss_scale = optim.loss_scale();
+    nsamples = batch_size;
+    aborted = false;
+  }
+
+  /// whether backward should run for a sample with this loss.
+  bool check_loss(const T& loss) {
+    if (!usable(loss) || static_cast<double>(loss) > max_loss * nsamples) {
+      aborted = true;
+    }
+    return !aborted;
+  }
+
+  /// whether the step goes on, given the mean loss of the batch.
+  bool check_batch(double batch_loss) {
+    if (!std::isnormal(batch_loss) || batch_loss > max_loss) {
+      aborted = true;
+    }
+    return !aborted;
+  }
+
+  /// apply the accumulated gradients; false if the step was aborted or its gradients were unusable.
+  bool update() {
+    if (aborted) {
+      return false;
+    }
+
+    auto& params = *net.param_block;
+    double sq = 0.0;
+    bool ok = true;
+    for (auto& x : params) {
+      if (!x.requires_grad) continue;
+      ok = ok && usable(x.grad);
+      double g = static_cast<double>(x.grad);
+      sq += g * g;
+    }
+    // mixed precision skips overflowing steps itself, and lowers its loss scale
+    if (!ok && !optim.handles_overflow()) {
+      std::cout << "[DEBUG] unusable gradients, step skipped" << std::endl;
+      return false;
+    }
+    grad_norm = std::sqrt(sq) / net.loss_scale;
+
+    if (ok && clip_norm > 0.0 && grad_norm > clip_norm) {
+      T factor(clip_norm / grad_norm);
+      for (auto& x : params) {
+        x.grad = x.grad * factor;
+      }
+    }
+
+    lr = schedule.at(step);
+    optim.step(params, lr);
+    ++step;
+    return true;
+  }
+};
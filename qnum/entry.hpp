@@ -4,12 +4,48 @@
 #include "data.hpp"
 #include "mlp.hpp"
 #include "cnn.hpp"
+#include "optim.hpp"
+#include "checkpoint.hpp"
+#include "metrics.hpp"
+#include "engine.hpp"
 #include <tuple>
+#include <map>
 
 using namespace std;
 
 int g_batch_size = 1;
 
+/// options passed as --name or --name=value, anywhere on the command line.
+std::map<std::string, std::string> g_options;
+
+/// move the options out of argv into g_options, leaving the positional arguments.
+void parse_options(int& argc, char* argv[]) {
+  int n = 1;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) != 0) {
+      argv[n++] = argv[i];
+      continue;
+    }
+    auto eq = arg.find('=');
+    if (eq == std::string::npos) {
+      g_options[arg.substr(2)] = "1";
+    } else {
+      g_options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+  }
+  argc = n;
+}
+
+bool has_option(const std::string& name) {
+  return g_options.count(name) != 0;
+}
+
+std::string option(const std::string& name, const std::string& def) {
+  auto it = g_options.find(name);
+  return it == g_options.end() ? def : it->second;
+}
+
 template<typename T>
 std::tuple<const dataset_t<T>*, const dataset_t<T>*> load_data(const string& dataset) {
   cout << "[DEBUG] loading data..." << endl;
@@ -32,45 +68,83 @@ template<typename T> nn_t<T>* init_net(const string& arch, int nhidden, const da
   if (arch == "mlp") {
     return new mlp_t<T>(ptrain->height * ptrain->width * ptrain->nchannel, nhidden, ptrain->nclass);
   } else if (arch == "cnn") {
-    return new cnn_t<T>(ptrain->nchannel, ptrain->height, ptrain->width, ptrain->nclass);
+    auto net = new cnn_t<T>(ptrain->nchannel, ptrain->height, ptrain->width, ptrain->nclass);
+    net->recompute = has_option("recompute");
+    return net;
   } else {
     printf("error: unrecognized network arch %s\n", arch.c_str());
     exit(-1);
   }
 }
 
+/// create the optimizer named by --optim (sgd, momentum, nesterov, adam, adamw) with its state in S.
+template<typename T, typename S>
+optim_t<T>* make_optim_with_state(const std::string& name) {
+  auto opt = [](const char* key, const char* def) { return std::stod(option(key, def)); };
+  if (name == "momentum" || name == "nesterov") {
+    return new momentum_t<T, S>(opt("momentum", "0.9"), name == "nesterov");
+  } else if (name == "adam") {
+    return new adam_t<T, S>(opt("beta1", "0.9"), opt("beta2", "0.999"), opt("eps", "1e-8"), opt("weight-decay", "0"));
+  } else if (name == "adamw") {
+    return new adam_t<T, S>(opt("beta1", "0.9"), opt("beta2", "0.999"), opt("eps", "1e-8"), opt("weight-decay", "0.01"));
+  }
+  printf("error: unrecognized optimizer %s\n", name.c_str());
+  exit(-1);
+}
+
+/// create the optimizer named by --optim, with its state in the type named by --optim-state:
+/// same (the parameter type), f32, or, in full builds, f64 and q16 (3 extension bits).
+template<typename T>
+optim_t<T>* make_optim(const std::string& name, const std::string& state) {
+  if (!std::is_same<T, float>::value && has_option("mixed-precision")) {
+    auto mixed = new mixed_precision_t<T>(make_optim<float>(name, state), std::stod(option("loss-scale", "1")));
+    std::cout << "[DEBUG] mixed precision, f32 master weights, loss scale " << mixed->scale << std::endl;
+    return mixed;
+  }
+  std::cout << "[DEBUG] optimizer " << name << ", state " << state << std::endl;
+  if (name == "sgd") return new sgd_t<T>();
+  if (state == "same") return make_optim_with_state<T, T>(name);
+  if (state == "f32") return make_optim_with_state<T, float>(name);
+#if !defined(PARTIAL_BUILD)
+  if (state == "f64") return make_optim_with_state<T, double>(name);
+  if (state == "q16") return make_optim_with_state<T, qnum::qspace_number_t<int16_t, 3>>(name);
+#endif
+  printf("error: unrecognized optimizer state type %s\n", state.c_str());
+  exit(-1);
+}
+
 // forward declaration
 template<typename T> void entry(int E, const string& arch, const string& dataset, double lr, int nhidden, const string& type, const char* checkpoint);
 
-template<typename T, int D, typename ... Args> void entry_wrap_q(int E, Args... args)
+template<typename T, int D, typename R, typename ... Args> void entry_wrap_q(int E, Args... args)
 {
   switch (E) {
 #if !defined(PARTIAL_BUILD)
     case 1:
-      entry<qspace_number_t<T, 1, D>>(E, args...);
+      entry<qspace_number_t<T, 1, D, true, R>>(E, args...);
       break;
     case 2:
-      entry<qspace_number_t<T, 2, D>>(E, args...);
+      entry<qspace_number_t<T, 2, D, true, R>>(E, args...);
       break;
 #endif
     case 3:
-      entry<qspace_number_t<T, 3, D>>(E, args...);
+      entry<qspace_number_t<T, 3, D, true, R>>(E, args...);
       break;
 #if !defined(PARTIAL_BUILD)
     case 4:
-      entry<qspace_number_t<T, 4, D>>(E, args...);
+      entry<qspace_number_t<T, 4, D, true, R>>(E, args...);
       break;
     case 5:
-      entry<qspace_number_t<T, 5, D>>(E, args...);
+      entry<qspace_number_t<T, 5, D, true, R>>(E, args...);
       break;
     case 6:
-      entry<qspace_number_t<T, 6, D>>(E, args...);
+      entry<qspace_number_t<T, 6, D, true, R>>(E, args...);
       break;
     case 7:
-      entry<qspace_number_t<T, 7, D>>(E, args...);
+      entry<qspace_number_t<T, 7, D, true, R>>(E, args...);
       break;
     case 8:
-      entry<qspace_number_t<T, 8, D>>(E, args...);
+      entry<qspace_number_t<T, 8, D, true, R>>(E, args...);
       break;
 #endif
     default:
@@ -78,34 +152,34 @@ template<typename T, int D, typename ... Args> void entry_wrap_q(int E, Args...
   }
 }
 
-template<int B, typename ... Args> void entry_wrap_flex16(int E, Args... args)
+template<int B, typename R, typename ... Args> void entry_wrap_flex16(int E, Args... args)
 {
   switch (E) {
 #if !defined(PARTIAL_BUILD)
     case 1:
-      entry<flexfloat<1, B - 2>>(E, args...);
+      entry<flexfloat<1, B - 2, R>>(E, args...);
       break;
     case 2:
-      entry<flexfloat<2, B - 3>>(E, args...);
+      entry<flexfloat<2, B - 3, R>>(E, args...);
       break;
     case 3:
-      entry<flexfloat<3, B - 4>>(E, args...);
+      entry<flexfloat<3, B - 4, R>>(E, args...);
       break;
     case 4:
-      entry<flexfloat<4, B - 5>>(E, args...);
+      entry<flexfloat<4, B - 5, R>>(E, args...);
       break;
     case 5:
-      entry<flexfloat<5, B - 6>>(E, args...);
+      entry<flexfloat<5, B - 6, R>>(E, args...);
       break;
     case 6:
-      entry<flexfloat<6, B - 7>>(E, args...);
+      entry<flexfloat<6, B - 7, R>>(E, args...);
       break;
     case 7:
-      entry<flexfloat<7, B - 8>>(E, args...);
+      entry<flexfloat<7, B - 8, R>>(E, args...);
       break;
 #endif
     case 8:
-      entry<flexfloat<8, B - 9>>(E, args...);
+      entry<flexfloat<8, B - 9, R>>(E, args...);
       break;
     default:
       std::cout << "unsupported extension bit number" << std::endl;
@@ -114,8 +188,29 @@ template<int B, typename ... Args> void entry_wrap_flex16(int E, Args... args)
 
 int launch(int argc, char* argv[]) {
 
+  parse_options(argc, argv);
+
   if (argc < 8) {
-    std::cout << "usage: " << argv[0] << " num_type arch[mlp|cnn] dataset[mnist|cifar10] batchsize ext_bits lr nhidden [checkpoint_file]" << std::endl;
+    std::cout << "usage: " << argv[0] << " num_type arch[mlp|cnn] dataset[mnist|cifar10] batchsize ext_bits lr nhidden [checkpoint_file] [options]" << std::endl;
+    std::cout << "options:" << std::endl;
+    std::cout << "  --recompute    recompute the conv layers during backward to save memory (cnn only)" << std::endl;
+    std::cout << "  --tape-stats=N log the size of the tape and the time spent per phase every N steps" << std::endl;
+    std::cout << "  --optim=NAME   sgd (default), momentum, nesterov, adam or adamw" << std::endl;
+    std::cout << "                 tuned with --momentum=0.9, --beta1=0.9, --beta2=0.999, --eps=1e-8, --weight-decay" << std::endl;
+    std::cout << "  --optim-state=TYPE  number type of the optimizer state: same (default), f32, f64 or q16" << std::endl;
+    std::cout << "  --mixed-precision   keep f32 master weights, updated by the optimizer and re-quantized every step" << std::endl;
+    std::cout << "  --loss-scale=S      multiply the loss by S before backward (mixed precision only, halved on overflow)" << std::endl;
+    std::cout << "  --epochs=N          number of epochs (default 20)" << std::endl;
+    std::cout << "  --lr-schedule=NAME  constant (default), step (times --lr-gamma=0.1 every --lr-step=N updates, default an epoch)" << std::endl;
+    std::cout << "                      or cosine (to zero at the last update), after --warmup=N updates of linear warmup" << std::endl;
+    std::cout << "  --clip-norm=X       scale the gradients down to a global norm of X" << std::endl;
+    std::cout << "  --max-loss=X        skip steps whose mean loss exceeds X (default 10), before backward where possible" << std::endl;
+    std::cout << "  --keep-checkpoints=K  keep only the last K checkpoints written by this run (default: all)" << std::endl;
+    std::cout << "  --metrics=FILE      record train/test metrics, histograms and saturation to FILE instead of [TRAIN] lines" << std::endl;
+    std::cout << "  --metrics-tsv       also write FILE-train.tsv and FILE-test.tsv (the columns of split_log.sh)" << std::endl;
+    std::cout << "  --hist-every=N      histogram the parameters every N steps (default 10), over --hist-bins=B bins of [-1, 1)" << std::endl;
+    std::cout << "  --hist-grad         histogram the gradients as well" << std::endl;
+    std::cout << "  --qnum-stats=N      report saturation and growth-mode counters per layer and op every N steps (QNUM_STATS builds)" << std::endl;
     return -1;
   }
 
@@ -132,34 +227,39 @@ int launch(int argc, char* argv[]) {
   }
 
 #if defined(PARTIAL_BUILD)
-  if(type == "q16") entry_wrap_q<int16_t, 0>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  if(type == "q16") entry_wrap_q<int16_t, 0, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
   else if (type == "f32") entry<float>(0, arch, dataset, lr, nhidden, type, chkpoint);
 #else
 
-  if(type == "q8") entry_wrap_q<int8_t, 0>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  if(type == "q8") entry_wrap_q<int8_t, 0, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+
+  //else if(type == "q11") entry_wrap_q<int16_t, 5, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if(type == "q12") entry_wrap_q<int16_t, 4, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if(type == "q13") entry_wrap_q<int16_t, 3, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if(type == "q14") entry_wrap_q<int16_t, 2, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if(type == "q15") entry_wrap_q<int16_t, 1, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  else if(type == "q16") entry_wrap_q<int16_t, 0, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
 
-  //else if(type == "q11") entry_wrap_q<int16_t, 5>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if(type == "q12") entry_wrap_q<int16_t, 4>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if(type == "q13") entry_wrap_q<int16_t, 3>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if(type == "q14") entry_wrap_q<int16_t, 2>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if(type == "q15") entry_wrap_q<int16_t, 1>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  else if(type == "q16") entry_wrap_q<int16_t, 0>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  // stochastic rounding
+  else if(type == "q8s") entry_wrap_q<int8_t, 0, qnum::round_stochastic>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  else if(type == "q16s") entry_wrap_q<int16_t, 0, qnum::round_stochastic>(E, arch, dataset, lr, nhidden, type, chkpoint);
 
-  else if (type == "q32") entry_wrap_q<int32_t, 0>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  else if (type == "q32") entry_wrap_q<int32_t, 0, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
 
   else if (type == "f32") entry<float>(0, arch, dataset, lr, nhidden, type, chkpoint);
   else if (type == "f64") entry<double>(0, arch, dataset, lr, nhidden, type, chkpoint);
 
-  //else if (type == "f11") entry_wrap_flex16<11>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f12") entry_wrap_flex16<12>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f13") entry_wrap_flex16<13>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f14") entry_wrap_flex16<14>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f15") entry_wrap_flex16<15>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  else if (type == "f16") entry_wrap_flex16<16>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f17") entry_wrap_flex16<17>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f18") entry_wrap_flex16<18>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f19") entry_wrap_flex16<19>(E, arch, dataset, lr, nhidden, type, chkpoint);
-  //else if (type == "f20") entry_wrap_flex16<20>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f11") entry_wrap_flex16<11, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f12") entry_wrap_flex16<12, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f13") entry_wrap_flex16<13, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f14") entry_wrap_flex16<14, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f15") entry_wrap_flex16<15, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  else if (type == "f16") entry_wrap_flex16<16, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  else if (type == "f16s") entry_wrap_flex16<16, qnum::round_stochastic>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f17") entry_wrap_flex16<17, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f18") entry_wrap_flex16<18, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f19") entry_wrap_flex16<19, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
+  //else if (type == "f20") entry_wrap_flex16<20, qnum::round_nearest>(E, arch, dataset, lr, nhidden, type, chkpoint);
 #endif
 
   else { cout << "unknown data type " << type << "." << endl; }
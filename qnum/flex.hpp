@@ -23,6 +23,7 @@
 #include <iostream>
 #include <sstream>
 #include <bitset>
+#include "rounding.hpp"
 
 
 // Collection of statistics
@@ -196,7 +197,8 @@ namespace flex{
 
 /* FLEXFLOAT CLASS */
 
-template <uint_fast8_t exp_bits, uint_fast8_t frac_bits> struct flexfloat {
+// R is the rounding policy (see rounding.hpp), applied to the double result before flexfloat_sanitize.
+template <uint_fast8_t exp_bits, uint_fast8_t frac_bits, typename R = qnum::round_nearest> struct flexfloat {
 
     flexfloat_t v;
     INLINE fp_t getValue() const {
@@ -233,14 +235,14 @@ template <uint_fast8_t exp_bits, uint_fast8_t frac_bits> struct flexfloat {
     }
 
     // Constructor from flexfloat types
-    template <uint_fast8_t e, uint_fast8_t f> INLINE flexfloat (const flexfloat<e, f> &w) {
+    template <uint_fast8_t e, uint_fast8_t f, typename r> INLINE flexfloat (const flexfloat<e, f, r> &w) {
 #ifdef FLEXFLOAT_STATS
         if(flexfloat_stats_enabled) {
             if(flexfloat_vectorization) vcasting_stats[make_precision(e, f, exp_bits, frac_bits)].total++;
             else casting_stats[make_precision(e, f, exp_bits, frac_bits)].total++;
         }
 #endif
-        v.value = w.getValue();
+        v.value = R::to_precision(w.getValue(), frac_bits);
         v.desc.exp_bits = exp_bits;
         v.desc.frac_bits = frac_bits;
         flexfloat_sanitize(&v);
@@ -248,7 +250,7 @@ template <uint_fast8_t exp_bits, uint_fast8_t frac_bits> struct flexfloat {
 
     // Constructor from castable type
     // Note: In the original flexfloat implementation this is a templated constructor.
-    // gcc seems to think that VectorXtvar<flex::flexfloat<E, F>> can cast to flexfloat, which
+    // gcc seems to think that VectorXtvar<flex::flexfloat<E, F, R>> can cast to flexfloat, which
     // fails compilation with ambiguous overload for operators (messing Eigen operators with flexfloat ones).
     // Workaround: don't use the template. The compiler doesn't do SFINE well here.
     INLINE flexfloat (const double &w)
@@ -260,7 +262,7 @@ template <uint_fast8_t exp_bits, uint_fast8_t frac_bits> struct flexfloat {
             else casting_stats[make_precision(p.first, p.second, exp_bits, frac_bits)].total++;
         }
 #endif
-        v.value = fp_t(w);
+        v.value = fp_t(R::to_precision(w, frac_bits));
         v.desc.exp_bits = exp_bits;
         v.desc.frac_bits = frac_bits;
 
@@ -403,8 +405,8 @@ template <uint_fast8_t exp_bits, uint_fast8_t frac_bits> struct flexfloat {
 
 /* Testing support */
 
-template <uint_fast8_t e, uint_fast8_t f>
-std::string bitstring(const flexfloat<e, f> &ff) noexcept
+template <uint_fast8_t e, uint_fast8_t f, typename r>
+std::string bitstring(const flexfloat<e, f, r> &ff) noexcept
 {
     std::stringstream buffer;
     buffer << flexfloat_as_bits << ff;
@@ -441,8 +443,8 @@ INLINE fp_t reinterpret_double_bits_as(uint64_t v) noexcept
 }
 
 /* ADD (+) */
-template<uint8_t E, uint8_t F>
-INLINE flexfloat<E, F> operator+(const flexfloat<E, F> &a, const flexfloat<E, F> &b)
+template<uint8_t E, uint8_t F, typename R>
+INLINE flexfloat<E, F, R> operator+(const flexfloat<E, F, R> &a, const flexfloat<E, F, R> &b)
 {
 #ifdef FLEXFLOAT_STATS
     if(flexfloat_stats_enabled) {
@@ -450,12 +452,12 @@ INLINE flexfloat<E, F> operator+(const flexfloat<E, F> &a, const flexfloat<E, F>
         else ops_stats[make_precision(exp_bits, frac_bits)].add++;
     }
 #endif
-    return flexfloat<E, F>(a.v.value + b.v.value);
+    return flexfloat<E, F, R>(a.v.value + b.v.value);
 }
 
  /* SUB (-) */
-template<uint8_t E, uint8_t F>
-INLINE flexfloat<E, F> operator-(const flexfloat<E, F> &a, const flexfloat<E, F> &b)
+template<uint8_t E, uint8_t F, typename R>
+INLINE flexfloat<E, F, R> operator-(const flexfloat<E, F, R> &a, const flexfloat<E, F, R> &b)
 {
 #ifdef FLEXFLOAT_STATS
     if(flexfloat_stats_enabled) {
@@ -463,12 +465,12 @@ INLINE flexfloat<E, F> operator-(const flexfloat<E, F> &a, const flexfloat<E, F>
         else ops_stats[make_precision(exp_bits, frac_bits)].sub++;
     }
 #endif
-    return flexfloat<E, F>(a.v.value - b.v.value);
+    return flexfloat<E, F, R>(a.v.value - b.v.value);
 }
 
  /* MUL (-) */
-template<uint8_t E, uint8_t F>
-INLINE flexfloat<E, F> operator*(const flexfloat<E, F> &a, const flexfloat<E, F> &b)
+template<uint8_t E, uint8_t F, typename R>
+INLINE flexfloat<E, F, R> operator*(const flexfloat<E, F, R> &a, const flexfloat<E, F, R> &b)
 {
 #ifdef FLEXFLOAT_STATS
     if(flexfloat_stats_enabled) {
@@ -476,12 +478,12 @@ INLINE flexfloat<E, F> operator*(const flexfloat<E, F> &a, const flexfloat<E, F>
         else ops_stats[make_precision(exp_bits, frac_bits)].mul++;
     }
 #endif
-    return flexfloat<E, F>(a.v.value * b.v.value);
+    return flexfloat<E, F, R>(a.v.value * b.v.value);
 }
 
  /* DIV (/) */
-template<uint8_t E, uint8_t F>
-INLINE flexfloat<E, F> operator/(const flexfloat<E, F> &a, const flexfloat<E, F> &b)
+template<uint8_t E, uint8_t F, typename R>
+INLINE flexfloat<E, F, R> operator/(const flexfloat<E, F, R> &a, const flexfloat<E, F, R> &b)
 {
 #ifdef FLEXFLOAT_STATS
     if(flexfloat_stats_enabled) {
@@ -489,14 +491,14 @@ INLINE flexfloat<E, F> operator/(const flexfloat<E, F> &a, const flexfloat<E, F>
         else ops_stats[make_precision(exp_bits, frac_bits)].div++;
     }
 #endif
-    return flexfloat<E, F>(a.v.value / b.v.value);
+    return flexfloat<E, F, R>(a.v.value / b.v.value);
 }
 
 /*------------------------------------------------------------------------
 | OPERATOR OVERLOADS: IO streams operators
 *------------------------------------------------------------------------*/
-template<uint8_t E, uint8_t F>
-std::ostream& operator<<(std::ostream& os, const flexfloat<E, F>& obj)
+template<uint8_t E, uint8_t F, typename R>
+std::ostream& operator<<(std::ostream& os, const flexfloat<E, F, R>& obj)
 {
     if(os.iword(get_manipulator_id()) == 0)
     {
@@ -532,52 +534,52 @@ using bfloat16_t = flexfloat<8, 7>;
 namespace std
 {
   using namespace flex;
-  template <uint8_t E, uint8_t F> struct is_floating_point<flexfloat<E, F>> : true_type { };
+  template <uint8_t E, uint8_t F, typename R> struct is_floating_point<flexfloat<E, F, R>> : true_type { };
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> ceil(const flexfloat<E, F>& q)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> ceil(const flexfloat<E, F, R>& q)
   {
-    return (flexfloat<E, F>)ceil((double)q);
+    return (flexfloat<E, F, R>)ceil((double)q);
   }
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> log10(const flexfloat<E, F>& q)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> log10(const flexfloat<E, F, R>& q)
   {
-    return (flexfloat<E, F>)log10((double)q);
+    return (flexfloat<E, F, R>)log10((double)q);
   }
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> log(const flexfloat<E, F>& q)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> log(const flexfloat<E, F, R>& q)
   {
-    return (flexfloat<E, F>)log((double)q);
+    return (flexfloat<E, F, R>)log((double)q);
   }
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> exp(const flexfloat<E, F>& q)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> exp(const flexfloat<E, F, R>& q)
   {
-    return (flexfloat<E, F>)exp((double)q);
+    return (flexfloat<E, F, R>)exp((double)q);
   }
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> abs(const flexfloat<E, F>& q)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> abs(const flexfloat<E, F, R>& q)
   {
     auto v = q;
     if (v < 0) v = -v;
     return v;
   }
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> copysign(const flexfloat<E, F>& a, const flexfloat<E, F>& b)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> copysign(const flexfloat<E, F, R>& a, const flexfloat<E, F, R>& b)
   {
     auto v = a;
     if (b < 0) a = -a;
     return a;
   }
 
-  template<uint8_t E, uint8_t F>
-  flexfloat<E, F> copysign(const double& a, const flexfloat<E, F>& b)
+  template<uint8_t E, uint8_t F, typename R>
+  flexfloat<E, F, R> copysign(const double& a, const flexfloat<E, F, R>& b)
   {
-    flexfloat<E, F> a_ = (flexfloat<E, F>)a;
+    flexfloat<E, F, R> a_ = (flexfloat<E, F, R>)a;
     if (b < 0) a_ = -a_;
     return a_;
   }
@@ -0,0 +1,62 @@
+#pragma once
+#include "common.hpp"
+#include <vector>
+
+/// maps a number to its (fractional) bin: one multiply-add on the value.
+template<typename T> struct bin_map_t {
+  double a, b;
+
+  bin_map_t(double lo, double hi, int nbins) : a(nbins / (hi - lo)), b(-lo * nbins / (hi - lo)) {}
+
+  double operator()(const T& x) const { return static_cast<double>(x) * a + b; }
+};
+
+/// qspace_number_t is binned from its backing integer, with the scale of its mode folded into
+/// the multiplier, so that no value is converted or aligned.
+template<typename Ts, int E, int D, bool G, typename R>
+struct bin_map_t<qnum::qspace_number_t<Ts, E, D, G, R>> {
+  using T = qnum::qspace_number_t<Ts, E, D, G, R>;
+  double a[2], b;
+
+  bin_map_t(double lo, double hi, int nbins) : b(-lo * nbins / (hi - lo)) {
+    double w = nbins / (hi - lo);
+    a[0] = w * (1.0 + T::ext_max()) / T::T_max();
+    a[1] = w * (1.0 + T::g_ext_max()) / T::T_max();
+  }
+
+  double operator()(const T& x) const { return x.val * a[x.growth] + b; }
+};
+
+/// histogram of the values (or gradients) of parameter nodes over nbins equal bins in [lo, hi).
+/// values below or above the range are counted in the first or last bin, NaN in the last.
+struct histogram_t {
+  double lo, hi;
+  bool grad;
+  std::vector<int> counts;
+
+  histogram_t(int nbins = 20, double lo = -1.0, double hi = 1.0, bool grad = false)
+    : lo(lo), hi(hi), grad(grad), counts(nbins) {}
+
+  /// an empty histogram with the same bins.
+  histogram_t like() const { return histogram_t(counts.size(), lo, hi, grad); }
+
+  template<typename It>
+  void add(It first, It last) {
+    using T = typename std::decay<decltype(first->val)>::type;
+    const bin_map_t<T> map(lo, hi, counts.size());
+    const double top = counts.size() - 1;
+    int* c = counts.data();
+    for (; first != last; ++first) {
+      double v = map(grad ? first->grad : first->val);
+      v = v < top ? v : top;
+      v = v > 0 ? v : 0;
+      ++c[static_cast<int>(v)];
+    }
+  }
+
+  void merge(const histogram_t& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+      counts[i] += other.counts[i];
+    }
+  }
+};
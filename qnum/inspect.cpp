@@ -11,7 +11,9 @@ template<typename T> void entry(int E, const string& arch, const string& dataset
 
   if(checkpoint != nullptr) {
     cout << "[DEBUG] Loading checkpoint from " << checkpoint << endl;
-    pnet->load(checkpoint);
+    if (!load_checkpoint(checkpoint, *pnet)) {
+      return;
+    }
   }
 
   //pnet->check_histogram();
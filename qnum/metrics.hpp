@@ -0,0 +1,220 @@
+#pragma once
+#include "histogram.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Training metrics, recorded from the training loop without blocking on I/O.
+/// records go through a single-producer single-consumer ring; a background thread drains it
+/// every flush interval into a binary file of blocks. each block is a uint32 record count n
+/// followed by the columns of its n records: kind, epoch, step, nupdates, a, b, c, then the
+/// histogram bins. with tsv enabled the train and test records are also appended to
+/// <file>-train.tsv and <file>-test.tsv, in the columns of split_log.sh.
+
+constexpr int c_metric_hist_bins = 20;
+
+enum metric_kind_t : uint32_t {
+  metric_train      = 0, // a = batch loss, b = average loss, c = accuracy
+  metric_test       = 1, // a = average loss, b = accuracy
+  metric_histogram  = 2, // hist = parameters per bin, a = lower bound, b = upper bound, c = 1 for gradients
+  metric_saturation = 3, // a = saturated values, b = saturated gradients, c = parameters
+};
+
+struct metric_t {
+  uint32_t kind;
+  int32_t  epoch;
+  int64_t  step;
+  int64_t  nupdates;
+  double   a, b, c;
+  int32_t  hist[c_metric_hist_bins];
+};
+
+/// lock-free ring of metric_t with one producer and one consumer. a full ring drops the record.
+template<size_t N>
+struct metric_ring_t {
+  static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+
+  bool push(const metric_t& m) {
+    auto h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == N) {
+      ++dropped;
+      return false;
+    }
+    slots[h & (N - 1)] = m;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// move everything pushed so far to out.
+  void drain(std::vector<metric_t>& out) {
+    auto t = tail.load(std::memory_order_relaxed);
+    auto h = head.load(std::memory_order_acquire);
+    for (; t != h; ++t) {
+      out.push_back(slots[t & (N - 1)]);
+    }
+    tail.store(t, std::memory_order_release);
+  }
+
+  std::atomic<size_t> dropped{0};
+
+private:
+  metric_t slots[N];
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
+struct metrics_sink_t {
+  metrics_sink_t(const std::string& name, bool tsv, int flush_ms = 200)
+    : flush_ms(flush_ms), ring(std::make_unique<metric_ring_t<4096>>()) {
+    fp = fopen(name.c_str(), "wb");
+    if (fp == nullptr) {
+      std::cout << "[DEBUG] cannot write metrics to " << name << std::endl;
+    }
+    if (tsv) {
+      fp_train = fopen((name + "-train.tsv").c_str(), "w");
+      fp_test = fopen((name + "-test.tsv").c_str(), "w");
+      if (fp_train) std::fprintf(fp_train, "num_updates\tepoch\tbatch_loss\tavg_loss\tacc\n");
+      if (fp_test) std::fprintf(fp_test, "epoch\tloss\tacc\n");
+    }
+    writer = std::thread([this]() { run(); });
+  }
+
+  ~metrics_sink_t() {
+    stopping = true;
+    writer.join();
+    for (FILE* f : {fp, fp_train, fp_test}) {
+      if (f != nullptr) fclose(f);
+    }
+    if (ring->dropped > 0) {
+      std::cout << "[DEBUG] " << ring->dropped << " metric records dropped" << std::endl;
+    }
+  }
+
+  void train(int epoch, int64_t step, int64_t nupdates, double batch_loss, double avg_loss, double acc) {
+    metric_t m = make(metric_train, epoch, step, nupdates);
+    m.a = batch_loss; m.b = avg_loss; m.c = acc;
+    ring->push(m);
+  }
+
+  void test(int epoch, double avg_loss, double acc) {
+    metric_t m = make(metric_test, epoch, 0, 0);
+    m.a = avg_loss; m.b = acc;
+    ring->push(m);
+  }
+
+  /// histograms with more bins than a record holds are stored with adjacent bins summed.
+  void histogram(int epoch, int64_t step, const histogram_t& hist) {
+    metric_t m = make(metric_histogram, epoch, step, 0);
+    m.a = hist.lo; m.b = hist.hi; m.c = hist.grad;
+    const size_t n = hist.counts.size();
+    for (size_t i = 0; i < n; ++i) {
+      m.hist[n <= c_metric_hist_bins ? i : i * c_metric_hist_bins / n] += hist.counts[i];
+    }
+    ring->push(m);
+  }
+
+  void saturation(int epoch, int64_t step, int nsat, int nsat_grad, int ntotal) {
+    metric_t m = make(metric_saturation, epoch, step, 0);
+    m.a = nsat; m.b = nsat_grad; m.c = ntotal;
+    ring->push(m);
+  }
+
+private:
+  static metric_t make(metric_kind_t kind, int epoch, int64_t step, int64_t nupdates) {
+    metric_t m;
+    std::memset(&m, 0, sizeof(m));
+    m.kind = kind;
+    m.epoch = epoch;
+    m.step = step;
+    m.nupdates = nupdates;
+    return m;
+  }
+
+  void run() {
+    std::vector<metric_t> batch;
+    while (true) {
+      bool last = stopping;
+      batch.clear();
+      ring->drain(batch);
+      if (!batch.empty()) write(batch);
+      if (last) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(flush_ms));
+    }
+  }
+
+  template<typename F>
+  void column(const std::vector<metric_t>& batch, F get) {
+    using V = decltype(get(batch[0]));
+    std::vector<V> col;
+    col.reserve(batch.size());
+    for (auto& m : batch) col.push_back(get(m));
+    fwrite(col.data(), sizeof(V), col.size(), fp);
+  }
+
+  void write(const std::vector<metric_t>& batch) {
+    if (fp != nullptr) {
+      uint32_t n = batch.size();
+      fwrite(&n, sizeof(n), 1, fp);
+      column(batch, [](const metric_t& m) { return m.kind; });
+      column(batch, [](const metric_t& m) { return m.epoch; });
+      column(batch, [](const metric_t& m) { return m.step; });
+      column(batch, [](const metric_t& m) { return m.nupdates; });
+      column(batch, [](const metric_t& m) { return m.a; });
+      column(batch, [](const metric_t& m) { return m.b; });
+      column(batch, [](const metric_t& m) { return m.c; });
+      for (auto& m : batch) fwrite(m.hist, sizeof(m.hist), 1, fp);
+      fflush(fp);
+    }
+    for (auto& m : batch) {
+      if (m.kind == metric_train && fp_train != nullptr) {
+        std::fprintf(fp_train, "%lld\t%d\t%g\t%g\t%g\n", static_cast<long long>(m.nupdates), m.epoch, m.a, m.b, m.c);
+      } else if (m.kind == metric_test && fp_test != nullptr) {
+        std::fprintf(fp_test, "%d\t%g\t%g\n", m.epoch, m.a, m.b);
+      }
+    }
+    if (fp_train) fflush(fp_train);
+    if (fp_test) fflush(fp_test);
+  }
+
+  int flush_ms;
+  std::unique_ptr<metric_ring_t<4096>> ring;
+  FILE* fp = nullptr;
+  FILE* fp_train = nullptr;
+  FILE* fp_test = nullptr;
+  std::atomic<bool> stopping{false};
+  std::thread writer;
+};
+
+/// read back a metrics file written by metrics_sink_t.
+inline std::vector<metric_t> read_metrics(const std::string& name) {
+  std::vector<metric_t> out;
+  FILE* fp = fopen(name.c_str(), "rb");
+  if (fp == nullptr) return out;
+  uint32_t n;
+  while (fread(&n, sizeof(n), 1, fp) == 1) {
+    std::vector<metric_t> batch(n);
+    auto column = [&](auto member) {
+      using V = std::remove_reference_t<decltype(batch[0].*member)>;
+      std::vector<V> col(n);
+      if (fread(col.data(), sizeof(V), n, fp) != n) return false;
+      for (uint32_t i = 0; i < n; ++i) batch[i].*member = col[i];
+      return true;
+    };
+    bool ok = column(&metric_t::kind) && column(&metric_t::epoch) && column(&metric_t::step) &&
+              column(&metric_t::nupdates) && column(&metric_t::a) && column(&metric_t::b) && column(&metric_t::c);
+    for (uint32_t i = 0; ok && i < n; ++i) {
+      ok = fread(batch[i].hist, sizeof(batch[i].hist), 1, fp) == 1;
+    }
+    if (!ok) break;
+    out.insert(out.end(), batch.begin(), batch.end());
+  }
+  fclose(fp);
+  return out;
+}
@@ -18,12 +18,13 @@ struct mlp_t : public nn_t<T> {
 
     nn_t<T>::register_params(w1);
     nn_t<T>::register_params(w2);
+    nn_t<T>::pack_params();
   }
 
   virtual vec forward(const vec& x) {
     auto bx = withb(x);
-    auto hx = withb(fc_layer(bx, w1, act_relu));
-    auto ox = fc_layer(hx, w2, act_identity);
+    auto hx = withb(qnum::stats::in_layer("fc1", [&]() { return fc_layer(bx, w1, act_relu); }));
+    auto ox = qnum::stats::in_layer("fc2", [&]() { return fc_layer(hx, w2, act_identity); });
     return ox;
   }
 
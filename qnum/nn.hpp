@@ -1,5 +1,13 @@
 #pragma once
 #include "common.hpp"
+#include "histogram.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <tuple>
+#include <utility>
 
 template<typename T>
 struct nn_t {
@@ -7,16 +15,40 @@ struct nn_t {
   using vec = VectorXtvar<T>;
   using var = autodiff::reverse::Variable<T>;
 
+  using param_t = autodiff::reverse::IndependentVariableExpr<T>;
+
   /// to be filled in instance ctor
   std::vector<var*> params;
 
+  /// rows and columns of every registered vector (one column) or matrix, in registration order.
+  std::vector<std::pair<int, int>> param_shapes;
+
+  /// the expression nodes of all parameters in one allocation, filled by pack_params.
+  /// the variables in params alias into it, so the per-parameter passes below stream through it.
+  std::shared_ptr<std::vector<param_t>> param_block = std::make_shared<std::vector<param_t>>();
+
+  /// the derivative the loss is seeded with in backward, i.e. the factor the gradients are scaled by.
+  double loss_scale = 1.0;
+
+  /// time spent in each phase of training since the last tape_report, summed over threads, in microseconds.
+  std::atomic<long long> us_forward{0}, us_rewrite{0}, us_sort{0}, us_backward{0};
+
+  static long long elapsed_us(std::chrono::steady_clock::time_point& since) {
+    auto now = std::chrono::steady_clock::now();
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(now - since).count();
+    since = now;
+    return us;
+  }
+
   void register_params(vec& v) {
+    param_shapes.emplace_back(v.size(), 1);
     for(int i=0;i<v.size(); ++i) {
       params.push_back(&v(i));
     }
   }
 
   void register_params(mat& m) {
+    param_shapes.emplace_back(m.rows(), m.cols());
     for(int r = 0; r < m.rows(); ++r) {
       for(int c = 0; c < m.cols(); ++c) {
         params.push_back(&m(r,c));
@@ -24,28 +56,48 @@ struct nn_t {
     }
   }
 
-  void save(const char* name) {
-    FILE* fp = fopen(name, "wb");
+  /// move the registered parameters into param_block; to be called at the end of the instance ctor.
+  void pack_params() {
+    auto& block = *param_block;
+    block.clear();
+    block.reserve(params.size());
+    for (var* x : params) {
+      block.emplace_back(x->expr->val);
+      block.back().requires_grad = x->expr->requires_grad;
+    }
+    for (size_t i = 0; i < params.size(); ++i) {
+      params[i]->expr = autodiff::reverse::ExprPtr<T>(param_block, &block[i]);
+    }
+  }
 
-    std::vector<T> v(params.size());
-    for(int i=0; i<params.size(); ++i) {
-      v[i] = params[i]->expr->val;
+  /// freeze (or unfreeze) parameters, e.g. to fine-tune the remaining layers.
+  /// frozen parameters are skipped by backward and keep their values.
+  void freeze(vec& v, bool frozen = true) {
+    for(int i=0;i<v.size(); ++i) {
+      v(i).requires_grad(!frozen);
     }
+  }
 
-    fwrite(v.data(), v.size() * sizeof(T), 1, fp);
-    fclose(fp);
+  void freeze(mat& m, bool frozen = true) {
+    for(int r = 0; r < m.rows(); ++r) {
+      for(int c = 0; c < m.cols(); ++c) {
+        m(r,c).requires_grad(!frozen);
+      }
+    }
   }
 
-  void load(const char* name) { 
+  /// read a checkpoint of the legacy headerless format, the raw values in T.
+  /// new checkpoints are written and read with save_checkpoint/load_checkpoint (checkpoint.hpp).
+  void load(const char* name) {
     FILE* fp = fopen(name, "rb");
 
-    std::vector<T> v(params.size());
+    std::vector<T> v(param_block->size());
 
     fread(v.data(), v.size() * sizeof(T), 1, fp);
     fclose(fp);
 
-    for(int i=0; i<params.size(); ++i) {
-      params[i]->expr->val = v[i];
+    for(size_t i=0; i<v.size(); ++i) {
+      (*param_block)[i].val = v[i];
     }
   }
 
@@ -65,79 +117,113 @@ struct nn_t {
       }
     }
 
+    qnum::stats::scope_t scope("backward");
+    auto t = std::chrono::steady_clock::now();
     //cout << "rewrite" << endl;
     loss.expr->rewrite();
+    us_rewrite += elapsed_us(t);
     std::vector<autodiff::reverse::Expr<T>*> vec;
     loss.expr->topology_sort(vec);
-    loss.expr->grad = T(1.0);
+    // drop inputs, biases and other constant subtrees before the sweep
+    autodiff::reverse::fold_constants(vec);
+    us_sort += elapsed_us(t);
+    loss.expr->grad = T(loss_scale);
     for(auto it = vec.rbegin(); it != vec.rend(); ++it) {
       (*it)->propagate_step();
     }
+    // the parameters outlive the graph and are sorted again next step
+    for(auto e: vec) {
+      e->color = 0;
+    }
+    us_backward += elapsed_us(t);
     //loss.expr->propagate(T(1.0));
   }
 
   void seed() {
-    for (var* x : params) {
-      x->seed();
+    for (auto& x : *param_block) {
+      x.grad = 0;
     }
   }
 
   void learn(const T& rate) {
-    for (var* x : params) {
-      x->expr->val -= x->grad() * rate;
+    for (auto& x : *param_block) {
+      x.val -= x.grad * rate;
     }
   }
 
-  void check_histogram() {
-    constexpr int nhist = 20;
-    std::vector<int> histogram(nhist);
-    std::vector<T> bucket_bounds(nhist);
-    double incr = 2.0 / nhist;
-    T cur = -1.0;
-    for(int i=0;i<nhist;++i) {
-      bucket_bounds[i] = cur;
-      cur += incr;
+  /// histogram of the parameter values (or gradients) in the bins of spec, in one pass over param_block.
+  /// with nthreads > 1 every thread bins a slice of the block and the results are merged.
+  histogram_t histogram(const histogram_t& spec = histogram_t(), int nthreads = 1) {
+    auto& block = *param_block;
+    histogram_t h = spec.like();
+    if (nthreads <= 1) {
+      h.add(block.begin(), block.end());
+      return h;
     }
-    bucket_bounds[nhist/2] = 0;
-
-    for(auto &x: params) {
-      auto &e = *x;
-      for(int k=0;k<nhist;++k) {
-        if (e.expr->val < bucket_bounds[k]) {
-          histogram[k]++;
-          break;
-        }
-      }
+    std::vector<histogram_t> parts(nthreads, spec.like());
+    std::vector<std::thread> threads;
+    size_t slice = (block.size() + nthreads - 1) / nthreads;
+    for (int k = 0; k < nthreads; ++k) {
+      threads.emplace_back([&, k]() {
+        size_t first = std::min(block.size(), k * slice);
+        size_t last = std::min(block.size(), first + slice);
+        parts[k].add(block.begin() + first, block.begin() + last);
+      });
     }
-    std::cout << "[DEBUG] Histogram :" ;
-    for(int i=0;i<nhist;++i) {
-      std::cout << " " << std::setw(5) << histogram[i];
+    for (auto& t : threads) {
+      t.join();
+    }
+    for (auto& p : parts) {
+      h.merge(p);
+    }
+    return h;
+  }
+
+  void check_histogram(const histogram_t& spec = histogram_t()) {
+    std::cout << (spec.grad ? "[DEBUG] Gradient histogram :" : "[DEBUG] Histogram :");
+    for(int n: histogram(spec).counts) {
+      std::cout << " " << std::setw(5) << n;
     }
     std::cout << std::endl;
   }
 
-  void check_saturation() {
+  /// the number of saturated values, saturated gradients, and parameters (qnum only, zeros otherwise).
+  std::tuple<int, int, int> saturation() {
+    int ntotal = 0;
+    int nsat = 0;
+    int nsat_grad = 0;
 
     if constexpr(is_qnum<T>::value) {
-      int ntotal = 0;
-      int nsat = 0;
-      int nsat_grad = 0;
-
-      for(auto &x: params) {
-        auto &e = *x;
+      for(auto &e: *param_block) {
         ++ntotal;
-        if (e.expr->val.saturated()) ++ nsat;
-        if (e.grad().saturated()) ++ nsat_grad;
+        if (e.val.saturated()) ++ nsat;
+        if (e.grad.saturated()) ++ nsat_grad;
       }
+    }
+    return std::make_tuple(nsat, nsat_grad, ntotal);
+  }
 
-      std::cout << "[DEBUG] Saturation: " << nsat << " / " << nsat_grad << " / " << ntotal << std::endl;
+  void check_saturation() {
+    if constexpr(is_qnum<T>::value) {
+      auto sat = saturation();
+      std::cout << "[DEBUG] Saturation: " << std::get<0>(sat) << " / " << std::get<1>(sat) << " / " << std::get<2>(sat) << std::endl;
     }
   }
 
+  /// log the statistics of a tape (taken before backward rewrites it) and the phase timings since the last report.
+  void tape_report(const autodiff::reverse::TapeStats& stats, int epoch, int step) {
+    std::cout << "[TAPE] epoch= "   << std::setw(3) << epoch
+              << " step= "          << std::setw(5) << step
+              << " forward_us= "    << us_forward.exchange(0)
+              << " rewrite_us= "    << us_rewrite.exchange(0)
+              << " sort_us= "       << us_sort.exchange(0)
+              << " backward_us= "   << us_backward.exchange(0)
+              << " " << stats << std::endl;
+  }
+
   void dump_weights() {
-    for(auto &x: params) {
-      auto &e = *x;
-      std::cout << "[DUMP] " << e.expr->val << std::endl;
+    for(auto &e: *param_block) {
+      std::cout << "[DUMP] " << e.val << std::endl;
     }
   }
 
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "common.hpp"
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/// convert between number types through double, unless they are the same type.
+template<typename To, typename From>
+To number_cast(const From& x) {
+  if constexpr(std::is_same<To, From>::value) {
+    return x;
+  } else {
+    return To(static_cast<double>(x));
+  }
+}
+
+/// optimizer over the parameters of a network, i.e. nn_t::param_block.
+/// every step updates each parameter from its gradient in a single pass, skipping frozen parameters.
+template<typename T>
+struct optim_t {
+  using param_t = autodiff::reverse::IndependentVariableExpr<T>;
+
+  virtual ~optim_t() {}
+
+  virtual void step(std::vector<param_t>& params, double lr) = 0;
+
+  /// the factor the loss is multiplied by before backward, see mixed_precision_t.
+  virtual double loss_scale() const { return 1.0; }
+
+  /// whether step() copes with saturated or non-finite gradients by itself.
+  virtual bool handles_overflow() const { return false; }
+
+  /// names the optimizer and thereby the layout of its state in checkpoints.
+  virtual std::string name() const = 0;
+
+  /// the state of the optimizer flattened to doubles, for checkpoints.
+  virtual std::vector<double> state() const { return {}; }
+
+  /// restore a state returned by state(); false if it does not fit this optimizer.
+  virtual bool load_state(const std::vector<double>& s) { return s.empty(); }
+};
+
+/// plain SGD in the parameter type, as nn_t::learn.
+template<typename T>
+struct sgd_t : public optim_t<T> {
+  using param_t = typename optim_t<T>::param_t;
+
+  virtual void step(std::vector<param_t>& params, double lr) {
+    T rate(lr);
+    for (auto& x : params) {
+      if (!x.requires_grad) continue;
+      x.val -= x.grad * rate;
+    }
+  }
+
+  virtual std::string name() const { return "sgd"; }
+};
+
+/// SGD with (optionally Nesterov) momentum. the velocities are held and updated in the number type S.
+template<typename T, typename S>
+struct momentum_t : public optim_t<T> {
+  using param_t = typename optim_t<T>::param_t;
+
+  S mu;
+  bool nesterov;
+  std::vector<S> velocity;
+
+  momentum_t(double mu, bool nesterov) : mu(mu), nesterov(nesterov) {}
+
+  virtual void step(std::vector<param_t>& params, double lr) {
+    velocity.resize(params.size());
+    for (size_t i = 0; i < params.size(); ++i) {
+      auto& x = params[i];
+      if (!x.requires_grad) continue;
+      auto g = number_cast<S>(x.grad);
+      auto& v = velocity[i];
+      v = mu * v + g;
+      auto d = nesterov ? g + mu * v : v;
+      x.val -= number_cast<T>(lr * static_cast<double>(d));
+    }
+  }
+
+  virtual std::string name() const { return nesterov ? "nesterov" : "momentum"; }
+
+  virtual std::vector<double> state() const {
+    std::vector<double> s;
+    for (auto& v : velocity) s.push_back(static_cast<double>(v));
+    return s;
+  }
+
+  virtual bool load_state(const std::vector<double>& s) {
+    velocity.clear();
+    for (auto v : s) velocity.push_back(number_cast<S>(v));
+    return true;
+  }
+};
+
+/// Adam, or AdamW with decoupled weight decay. the moments are held in the number type S.
+/// the second moment is kept as its square root, which has the range of the gradients themselves
+/// instead of their squares, so that it does not underflow in fixed point; it is updated in double.
+template<typename T, typename S>
+struct adam_t : public optim_t<T> {
+  using param_t = typename optim_t<T>::param_t;
+
+  S beta1, one_minus_beta1;
+  double b1, b2, eps, weight_decay;
+  int t = 0;
+  std::vector<S> m, rms;
+
+  adam_t(double beta1, double beta2, double eps, double weight_decay)
+    : beta1(beta1), one_minus_beta1(1.0 - beta1),
+      b1(beta1), b2(beta2), eps(eps), weight_decay(weight_decay) {}
+
+  virtual void step(std::vector<param_t>& params, double lr) {
+    m.resize(params.size());
+    rms.resize(params.size());
+    ++t;
+    const double c1 = 1.0 / (1.0 - std::pow(b1, t));
+    const double c2 = 1.0 / std::sqrt(1.0 - std::pow(b2, t));
+    for (size_t i = 0; i < params.size(); ++i) {
+      auto& x = params[i];
+      if (!x.requires_grad) continue;
+      auto g = number_cast<S>(x.grad);
+      m[i] = beta1 * m[i] + one_minus_beta1 * g;
+      double r = static_cast<double>(rms[i]);
+      double gd = static_cast<double>(g);
+      rms[i] = number_cast<S>(std::sqrt(b2 * r * r + (1.0 - b2) * gd * gd));
+      double mhat = static_cast<double>(m[i]) * c1;
+      double rhat = std::abs(static_cast<double>(rms[i])) * c2;
+      double d = mhat / (rhat + eps);
+      if (weight_decay != 0.0) {
+        d += weight_decay * static_cast<double>(x.val);
+      }
+      x.val -= number_cast<T>(lr * d);
+    }
+  }
+
+  virtual std::string name() const { return weight_decay != 0.0 ? "adamw" : "adam"; }
+
+  /// t, then the first moments, then the second moments (as rms).
+  virtual std::vector<double> state() const {
+    std::vector<double> s{static_cast<double>(t)};
+    for (auto& v : m) s.push_back(static_cast<double>(v));
+    for (auto& v : rms) s.push_back(static_cast<double>(v));
+    return s;
+  }
+
+  virtual bool load_state(const std::vector<double>& s) {
+    if (s.size() % 2 != 1) return false;
+    size_t n = s.size() / 2;
+    t = static_cast<int>(s[0]);
+    m.clear();
+    rms.clear();
+    for (size_t i = 0; i < n; ++i) {
+      m.push_back(number_cast<S>(s[1 + i]));
+      rms.push_back(number_cast<S>(s[1 + n + i]));
+    }
+    return true;
+  }
+};
+
+/// mixed precision training: f32 master copies of the parameters are updated by an f32 optimizer
+/// and re-quantized into the working copies in T after every step, so that small updates are not
+/// lost to the rounding of T. forward and backward run in T on the loss multiplied by the loss scale,
+/// and the gradients are unscaled into the masters. a step with overflowing gradients is skipped
+/// and the scale halved.
+template<typename T>
+struct mixed_precision_t : public optim_t<T> {
+  using param_t = typename optim_t<T>::param_t;
+  using master_t = typename optim_t<float>::param_t;
+
+  std::unique_ptr<optim_t<float>> optim;
+  std::vector<master_t> master;
+  double scale;
+
+  mixed_precision_t(optim_t<float>* optim, double scale) : optim(optim), scale(scale) {
+    // the seed of backward must be representable in T
+    while (this->scale > 1.0 && static_cast<double>(number_cast<T>(this->scale)) < 0.99 * this->scale) {
+      this->scale /= 2;
+    }
+  }
+
+  virtual double loss_scale() const { return scale; }
+
+  virtual bool handles_overflow() const { return true; }
+
+  virtual void step(std::vector<param_t>& params, double lr) {
+    if (master.empty()) {
+      master.reserve(params.size());
+      for (auto& x : params) {
+        master.emplace_back(static_cast<float>(static_cast<double>(x.val)));
+        master.back().requires_grad = x.requires_grad;
+      }
+    }
+
+    bool overflow = false;
+    for (size_t i = 0; i < params.size(); ++i) {
+      if constexpr(is_qnum<T>::value) {
+        overflow = overflow || params[i].grad.saturated();
+      }
+      float g = static_cast<float>(static_cast<double>(params[i].grad) / scale);
+      overflow = overflow || !std::isfinite(g);
+      master[i].grad = g;
+      master[i].requires_grad = params[i].requires_grad;
+    }
+    if (overflow) {
+      scale = std::max(1.0, scale / 2);
+      std::cout << "[DEBUG] gradient overflow, step skipped, loss scale " << scale << std::endl;
+      return;
+    }
+
+    optim->step(master, lr);
+    for (size_t i = 0; i < params.size(); ++i) {
+      params[i].val = number_cast<T>(master[i].val);
+    }
+  }
+
+  virtual std::string name() const { return "mixed-" + optim->name(); }
+
+  /// the loss scale, the number of masters, the masters, then the state of the f32 optimizer.
+  virtual std::vector<double> state() const {
+    std::vector<double> s{scale, static_cast<double>(master.size())};
+    for (auto& x : master) s.push_back(x.val);
+    auto inner = optim->state();
+    s.insert(s.end(), inner.begin(), inner.end());
+    return s;
+  }
+
+  virtual bool load_state(const std::vector<double>& s) {
+    if (s.size() < 2 || s.size() < 2 + static_cast<size_t>(s[1])) return false;
+    size_t n = static_cast<size_t>(s[1]);
+    scale = s[0];
+    master.clear();
+    master.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+      master.emplace_back(static_cast<float>(s[2 + i]));
+    }
+    return optim->load_state(std::vector<double>(s.begin() + 2 + n, s.end()));
+  }
+};
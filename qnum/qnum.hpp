@@ -6,6 +6,9 @@
 #include <tuple>
 #include <cmath>
 
+#include "rounding.hpp"
+#include "stats.hpp"
+
 /// Q-Space arithmetic definition
 namespace qnum {
 
@@ -40,7 +43,9 @@ template <> struct number_traits<int64_t> {
 /// - int E: the number of extension bits
 /// - int D: the number of bits reduced. If 0, the significants
 ///          will take std::numeric_limits<T>::digits - E bits.
-template <typename T, int E, int D=0, bool G=true>
+/// - bool G: whether values beyond the extension range switch to growth mode.
+/// - typename R: the rounding policy of conversions, mul and div (see rounding.hpp).
+template <typename T, int E, int D=0, bool G=true, typename R=round_nearest>
 struct qspace_number_t
 {
   using T2x = typename number_traits<T>::T2x;
@@ -58,16 +63,22 @@ public:
 
     if (G && (v > upper || v < -upper)) {
       growth = true;
+      if constexpr(stats::enabled) {
+        stats::record(stats::op_convert, false, true, v > g_upper || v < -g_upper, true);
+      }
       if (v > g_upper) v = g_upper;
       if (v < -g_upper) v = -g_upper;
-      val = static_cast<T>(v / (g_upper) * T_max());
+      val = static_cast<T>(R::to_integer(v / (g_upper) * T_max()));
     } else {
-      val = static_cast<T>(v / (upper) * T_max());
+      val = static_cast<T>(R::to_integer(v / (upper) * T_max()));
       growth = false;
+      if constexpr(stats::enabled) {
+        stats::record(stats::op_convert, false, false, false, false);
+      }
     }
 
   }
-  qspace_number_t(const int& v) : qspace_number_t<T, E, D, G>(static_cast<double>(v)) { }
+  qspace_number_t(const int& v) : qspace_number_t<T, E, D, G, R>(static_cast<double>(v)) { }
 
   // TODO handle growth change
   qspace_number_t next() const {
@@ -97,11 +108,11 @@ public:
     return to_double();
   }
 
-  qspace_number_t<T, E, D, G> neg() const {
+  qspace_number_t<T, E, D, G, R> neg() const {
     return from_literal(-val, growth);
   }
 
-  std::tuple<T, T, bool> align(const qspace_number_t<T, E, D, G>& rhs) const {
+  std::tuple<T, T, bool> align(const qspace_number_t<T, E, D, G, R>& rhs) const {
     T l = val;
     T r = rhs.val;
     bool g = G && (growth || rhs.growth);
@@ -114,50 +125,57 @@ public:
     return std::make_tuple(l, r, g);
   }
 
-  qspace_number_t<T, E, D, G> add(const qspace_number_t<T, E, D, G>& rhs) const {
-    qspace_number_t<T, E, D, G> ret;
+  qspace_number_t<T, E, D, G, R> add(const qspace_number_t<T, E, D, G, R>& rhs) const {
+    qspace_number_t<T, E, D, G, R> ret;
     auto [l, r, g] = align(rhs);
     T2x tmp = T2x(l) + T2x(r);
+    bool g_in = g;
     g = grow(tmp, g);
     ret.val = saturate(tmp);
     ret.growth = g;
     ret.shrink();
+    count(stats::op_add, g_in, g, tmp, ret.growth);
     return ret;
   }
 
-  qspace_number_t<T, E, D, G> sub(const qspace_number_t<T, E, D, G>& rhs) const {
-    qspace_number_t<T, E, D, G> ret;
+  qspace_number_t<T, E, D, G, R> sub(const qspace_number_t<T, E, D, G, R>& rhs) const {
+    qspace_number_t<T, E, D, G, R> ret;
     auto [l, r, g] = align(rhs);
     T2x tmp = static_cast<T2x>(l) - static_cast<T2x>(r);
+    bool g_in = g;
     g = grow(tmp, g);
     ret.val = saturate(tmp);
     ret.growth = g;
     ret.shrink();
+    count(stats::op_sub, g_in, g, tmp, ret.growth);
     return ret;
   }
 
-  qspace_number_t<T, E, D, G> mul(const qspace_number_t<T, E, D, G>& rhs) const {
-    qspace_number_t<T, E, D, G> ret;
+  qspace_number_t<T, E, D, G, R> mul(const qspace_number_t<T, E, D, G, R>& rhs) const {
+    qspace_number_t<T, E, D, G, R> ret;
     auto [l, r, g] = align(rhs);
     T2x tmp = static_cast<T2x>(l) * static_cast<T2x>(r);
+    bool g_in = g;
     if (g) { 
-      tmp += g_K(); 
-      ret.val = saturate(tmp >> g_frac_bits());
+      tmp += R::template bias<T2x>(g_frac_bits());
+      tmp >>= g_frac_bits();
+      ret.val = saturate(tmp);
       ret.growth = true;
     }
     else { 
-      tmp += K(); 
+      tmp += R::template bias<T2x>(frac_bits());
       tmp >>= frac_bits();
       g = grow(tmp, false);
       ret.val = saturate(tmp);
       ret.growth = g;
     }
     ret.shrink();
+    count(stats::op_mul, g_in, g, tmp, ret.growth);
     return ret;
   }
 
-  qspace_number_t<T, E, D, G> div(const qspace_number_t<T, E, D, G>& rhs) const {
-    qspace_number_t<T, E, D, G> ret;
+  qspace_number_t<T, E, D, G, R> div(const qspace_number_t<T, E, D, G, R>& rhs) const {
+    qspace_number_t<T, E, D, G, R> ret;
     auto [l, r, g] = align(rhs);
     // pre-scaling up
     T2x tmp = static_cast<T2x>(l);
@@ -167,61 +185,59 @@ public:
       tmp <<= frac_bits();
     }
     // rounding
-    if ((tmp >= 0 && r >= 0) || (tmp < 0 && r < 0)) {
-      tmp += r / 2 - 1;
-    } else {
-      tmp -= r/ 2;
-    }
+    tmp += R::template div_bias<T2x>(tmp, r);
     tmp /= r;
+    bool g_in = g;
     g = grow(tmp, g);
     ret.val = saturate(tmp);
     ret.growth = g;
     ret.shrink();
+    count(stats::op_div, g_in, g, tmp, ret.growth);
     return ret;
   }
 
-  bool operator == (const qspace_number_t<T, E, D, G>& rhs) const {
+  bool operator == (const qspace_number_t<T, E, D, G, R>& rhs) const {
     auto [l, r, _] = align(rhs);
     return l == r;
   }
 
-  bool operator < (const qspace_number_t<T, E, D, G>& rhs) const {
+  bool operator < (const qspace_number_t<T, E, D, G, R>& rhs) const {
     auto [l, r, _] = align(rhs);
     return l < r;
   }
 
-  bool operator != (const qspace_number_t<T, E, D, G>& rhs) const {
+  bool operator != (const qspace_number_t<T, E, D, G, R>& rhs) const {
     return !(*this == rhs);
   }
 
-  bool operator <= (const qspace_number_t<T, E, D, G>& rhs) const {
+  bool operator <= (const qspace_number_t<T, E, D, G, R>& rhs) const {
     return *this < rhs || *this == rhs;
   }
 
-  bool operator > (const qspace_number_t<T, E, D, G>& rhs) const {
+  bool operator > (const qspace_number_t<T, E, D, G, R>& rhs) const {
     return rhs < *this;
   }
 
-  bool operator >= (const qspace_number_t<T, E, D, G>& rhs) const {
+  bool operator >= (const qspace_number_t<T, E, D, G, R>& rhs) const {
     return rhs <= *this;
   }
 
-  qspace_number_t<T, E, D, G>& operator += (const qspace_number_t<T, E, D, G>& rhs) {
+  qspace_number_t<T, E, D, G, R>& operator += (const qspace_number_t<T, E, D, G, R>& rhs) {
     *this = *this + rhs;
     return *this;
   }
 
-  qspace_number_t<T, E, D, G>& operator -= (const qspace_number_t<T, E, D, G>& rhs) {
+  qspace_number_t<T, E, D, G, R>& operator -= (const qspace_number_t<T, E, D, G, R>& rhs) {
     *this = *this - rhs;
     return *this;
   }
 
-  qspace_number_t<T, E, D, G>& operator *= (const qspace_number_t<T, E, D, G>& rhs) {
+  qspace_number_t<T, E, D, G, R>& operator *= (const qspace_number_t<T, E, D, G, R>& rhs) {
     *this = *this * rhs;
     return *this;
   }
 
-  qspace_number_t<T, E, D, G>& operator /= (const qspace_number_t<T, E, D, G>& rhs) {
+  qspace_number_t<T, E, D, G, R>& operator /= (const qspace_number_t<T, E, D, G, R>& rhs) {
     *this = *this / rhs;
     return *this;
   }
@@ -236,13 +252,20 @@ public:
     return static_cast<T>(v);
   }
 
-  static qspace_number_t<T, E, D, G> from_literal(const T& t, bool growth) {
-    qspace_number_t<T, E, D, G> ret;
+  static qspace_number_t<T, E, D, G, R> from_literal(const T& t, bool growth) {
+    qspace_number_t<T, E, D, G, R> ret;
     ret.val = t;
     ret.growth = growth;
     return ret;
   }
 
+  /// telemetry hook of the ops, see stats.hpp. v is the result before saturate.
+  static void count(stats::op_t op, bool g_in, bool g_out, const T2x& v, bool g_final) {
+    if constexpr(stats::enabled) {
+      stats::record(op, g_in, g_out, v > T_max() || v < T_min(), g_final);
+    }
+  }
+
   static bool grow(T2x& v, bool g) {
     if (!G) {
       return false;
@@ -289,34 +312,34 @@ public:
   static constexpr T g_threshold_min() { return T_min() >> g_shift(); }
 };
 
-template <typename T, int E, int D, bool G>
-std::ostream& operator << (std::ostream& os, const qspace_number_t<T, E, D, G>& qnum) {
+template <typename T, int E, int D, bool G, typename R>
+std::ostream& operator << (std::ostream& os, const qspace_number_t<T, E, D, G, R>& qnum) {
   return os << qnum.to_double();
 }
 
-template <typename T, int E, int D, bool G>
-qspace_number_t<T, E, D, G> operator - (const qspace_number_t<T, E, D, G> &x) {
+template <typename T, int E, int D, bool G, typename R>
+qspace_number_t<T, E, D, G, R> operator - (const qspace_number_t<T, E, D, G, R> &x) {
   return x.neg();
 }
 
 
-template <typename T, int E, int D, bool G>
-qspace_number_t<T, E, D, G> operator + (const qspace_number_t<T, E, D, G> &lhs, const qspace_number_t<T, E, D, G> &rhs) {
+template <typename T, int E, int D, bool G, typename R>
+qspace_number_t<T, E, D, G, R> operator + (const qspace_number_t<T, E, D, G, R> &lhs, const qspace_number_t<T, E, D, G, R> &rhs) {
   return lhs.add(rhs);
 }
 
-template <typename T, int E, int D, bool G>
-qspace_number_t<T, E, D, G> operator - (const qspace_number_t<T, E, D, G> &lhs, const qspace_number_t<T, E, D, G> &rhs) {
+template <typename T, int E, int D, bool G, typename R>
+qspace_number_t<T, E, D, G, R> operator - (const qspace_number_t<T, E, D, G, R> &lhs, const qspace_number_t<T, E, D, G, R> &rhs) {
   return lhs.sub(rhs);
 }
 
-template <typename T, int E, int D, bool G>
-qspace_number_t<T, E, D, G> operator * (const qspace_number_t<T, E, D, G> &lhs, const qspace_number_t<T, E, D, G> &rhs) {
+template <typename T, int E, int D, bool G, typename R>
+qspace_number_t<T, E, D, G, R> operator * (const qspace_number_t<T, E, D, G, R> &lhs, const qspace_number_t<T, E, D, G, R> &rhs) {
   return lhs.mul(rhs);
 }
 
-template <typename T, int E, int D, bool G>
-qspace_number_t<T, E, D, G> operator / (const qspace_number_t<T, E, D, G> &lhs, const qspace_number_t<T, E, D, G> &rhs) {
+template <typename T, int E, int D, bool G, typename R>
+qspace_number_t<T, E, D, G, R> operator / (const qspace_number_t<T, E, D, G, R> &lhs, const qspace_number_t<T, E, D, G, R> &rhs) {
   return lhs.div(rhs);
 }
 
@@ -325,6 +348,9 @@ template<int E=1> using qnum8_t  = qspace_number_t<int8_t, E>;
 template<int E=4> using qnum16_t = qspace_number_t<int16_t, E>;
 template<int E=6> using qnum32_t  = qspace_number_t<int32_t, E>;
 
+template<int E=1> using qnum8s_t  = qspace_number_t<int8_t, E, 0, true, round_stochastic>;
+template<int E=4> using qnum16s_t = qspace_number_t<int16_t, E, 0, true, round_stochastic>;
+
 }
 
 /// std supporting types and helpers
@@ -332,52 +358,52 @@ namespace std
 {
   using namespace qnum;
 
-  template <typename T, int E, int D, bool G> struct is_floating_point<qspace_number_t<T, E, D, G>> : true_type { };
+  template <typename T, int E, int D, bool G, typename R> struct is_floating_point<qspace_number_t<T, E, D, G, R>> : true_type { };
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> ceil(const qspace_number_t<T, E, D, G>& q) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> ceil(const qspace_number_t<T, E, D, G, R>& q) noexcept
   {
     return ceil(q.to_double());
   }
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> log10(const qspace_number_t<T, E, D, G>& q) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> log10(const qspace_number_t<T, E, D, G, R>& q) noexcept
   {
     return log10(q.to_double());
   }
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> log(const qspace_number_t<T, E, D, G>& q) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> log(const qspace_number_t<T, E, D, G, R>& q) noexcept
   {
     return log(q.to_double());
   }
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> exp(const qspace_number_t<T, E, D, G>& q) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> exp(const qspace_number_t<T, E, D, G, R>& q) noexcept
   {
     return exp(q.to_double());
   }
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> abs(const qspace_number_t<T, E, D, G>& q) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> abs(const qspace_number_t<T, E, D, G, R>& q) noexcept
   {
     auto val = q.val;
     if (val < 0) val = -val;
-    return qspace_number_t<T, E, D, G>::from_literal(val, q.growth);
+    return qspace_number_t<T, E, D, G, R>::from_literal(val, q.growth);
   }
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> copysign(const qspace_number_t<T, E, D, G>& a, const qspace_number_t<T, E, D, G>& b) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> copysign(const qspace_number_t<T, E, D, G, R>& a, const qspace_number_t<T, E, D, G, R>& b) noexcept
   {
     auto val = a.val;
     if (b.val < 0) val = -val;
-    return qspace_number_t<T, E, D, G>::from_literal(val, a.growth);
+    return qspace_number_t<T, E, D, G, R>::from_literal(val, a.growth);
   }
 
-  template<typename T, int E, int D, bool G>
-  qspace_number_t<T, E, D, G> copysign(const double& a, const qspace_number_t<T, E, D, G>& b) noexcept
+  template<typename T, int E, int D, bool G, typename R>
+  qspace_number_t<T, E, D, G, R> copysign(const double& a, const qspace_number_t<T, E, D, G, R>& b) noexcept
   {
-    qspace_number_t<T, E, D, G> a_ = a;
+    qspace_number_t<T, E, D, G, R> a_ = a;
     if (b.val < 0) a_ = -a_;
     return a_;
   }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+
+/// Rounding policies for the narrow number types, selected by their R template parameter.
+/// For qspace_number_t a policy provides the bias added before a right shift by `shift` bits (mul),
+/// the bias added to a dividend before an integer division (div), and the rounding of a scaled value
+/// to the backing integer (conversion from double, truncated toward zero afterwards). For flexfloat
+/// it rounds a double to `frac_bits` fraction bits before flexfloat_sanitize.
+namespace qnum {
+
+/// Per-thread counter-based random numbers: the SplitMix64 finalizer applied to a Weyl sequence.
+/// Every thread starts from its own counter, so no state is shared and draws cost a few instructions.
+struct rounding_rng {
+  static uint64_t& counter() {
+    static thread_local uint64_t c = 0x9e3779b97f4a7c15ull * (1 + reinterpret_cast<uintptr_t>(&c));
+    return c;
+  }
+
+  static void seed(uint64_t s) { counter() = s; }
+
+  static uint64_t next() {
+    uint64_t z = (counter() += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  /// uniform in [0, 1)
+  static double uniform() { return (next() >> 11) * 0x1.0p-53; }
+};
+
+/// round to nearest, the behaviour of the types without a policy.
+struct round_nearest {
+  template<typename T2x> static T2x bias(int shift) { return T2x(1) << (shift - 1); }
+
+  template<typename T2x, typename T> static T2x div_bias(const T2x& num, const T& den) {
+    if ((num >= 0 && den >= 0) || (num < 0 && den < 0)) {
+      return den / 2 - 1;
+    } else {
+      return -(den / 2);
+    }
+  }
+
+  static double to_integer(double x) { return x; }
+
+  /// left to flexfloat_sanitize
+  static double to_precision(double x, int) { return x; }
+};
+
+/// stochastic rounding: round up with a probability equal to the fraction that is cut off, so that
+/// the rounding is unbiased and updates smaller than the resolution survive on average.
+struct round_stochastic {
+  template<typename T2x> static T2x bias(int shift) {
+    return static_cast<T2x>(rounding_rng::next() & ((uint64_t(1) << shift) - 1));
+  }
+
+  template<typename T2x, typename T> static T2x div_bias(const T2x& num, const T& den) {
+    uint64_t mag = den < 0 ? -static_cast<int64_t>(den) : den;
+    if (mag == 0) return 0;
+    T2x u = static_cast<T2x>(rounding_rng::next() % mag);
+    return ((num >= 0 && den >= 0) || (num < 0 && den < 0)) ? u : -u;
+  }
+
+  /// floor after a uniform offset, so that the truncation toward zero that follows is exact
+  static double to_integer(double x) { return std::floor(x + rounding_rng::uniform()); }
+
+  /// add a random value below the last kept bit to the magnitude and cut the dropped bits,
+  /// which then leaves nothing for flexfloat_sanitize to round (except for denormals of the target).
+  static double to_precision(double x, int frac_bits) {
+    if (frac_bits >= 52 || x == 0 || !std::isfinite(x)) return x;
+    uint64_t u;
+    std::memcpy(&u, &x, sizeof(u));
+    const uint64_t mask = (uint64_t(1) << (52 - frac_bits)) - 1;
+    u = (u + (rounding_rng::next() & mask)) & ~mask;
+    std::memcpy(&x, &u, sizeof(x));
+    return x;
+  }
+};
+
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// Saturation and growth-mode telemetry of qspace_number_t, compiled in with -DQNUM_STATS.
+/// every arithmetic op counts itself, whether it ran in growth mode, entered growth mode,
+/// saturated, or shrank back to normal mode. the counters are thread local and attributed to
+/// the layer named by the innermost stats::scope_t of the thread; report() sums them over all
+/// threads and prints what changed since the previous report.
+/// without QNUM_STATS the hooks compile away and scope_t is empty.
+namespace qnum {
+namespace stats {
+
+#if defined(QNUM_STATS)
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+enum op_t { op_add, op_sub, op_mul, op_div, op_convert, op_count };
+
+inline const char* op_name(int op) {
+  static const char* names[op_count] = {"add", "sub", "mul", "div", "convert"};
+  return names[op];
+}
+
+/// layer 0 collects everything outside a scope, and the layers beyond the table.
+constexpr int c_max_layers = 32;
+
+enum counter_t { c_ops, c_growth_ops, c_grow, c_saturate, c_shrink, c_counters };
+
+struct totals_t {
+  uint64_t n[c_max_layers][op_count][c_counters];
+};
+
+struct registry_t;
+registry_t& registry();
+
+/// the counters of one thread. only the owning thread writes them, with relaxed loads and stores
+/// instead of read-modify-writes, so that report() may read them concurrently.
+struct local_t {
+  std::atomic<uint64_t> n[c_max_layers][op_count][c_counters];
+  int layer = 0;
+
+  local_t();
+  ~local_t();
+
+  void add(int op, counter_t c) {
+    auto& x = n[layer][op][c];
+    x.store(x.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+};
+
+struct registry_t {
+  std::mutex mutex;
+  std::vector<std::string> layers{"other"};
+  std::vector<local_t*> live;
+  totals_t dead{};  // counters of the threads that have exited
+  totals_t last{};  // sums at the previous report
+
+  int layer_id(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = std::find(layers.begin(), layers.end(), name);
+    if (it != layers.end()) return it - layers.begin();
+    if (static_cast<int>(layers.size()) == c_max_layers) return 0;
+    layers.emplace_back(name);
+    return layers.size() - 1;
+  }
+
+  /// to be called with the mutex held.
+  void sum(totals_t& out) {
+    out = dead;
+    for (auto* l : live) {
+      for (int i = 0; i < c_max_layers; ++i)
+        for (int o = 0; o < op_count; ++o)
+          for (int c = 0; c < c_counters; ++c)
+            out.n[i][o][c] += l->n[i][o][c].load(std::memory_order_relaxed);
+    }
+  }
+};
+
+inline registry_t& registry() {
+  static registry_t r;
+  return r;
+}
+
+inline local_t::local_t() {
+  for (auto& l : n) for (auto& o : l) for (auto& c : o) c.store(0, std::memory_order_relaxed);
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.live.push_back(this);
+}
+
+inline local_t::~local_t() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (int i = 0; i < c_max_layers; ++i)
+    for (int o = 0; o < op_count; ++o)
+      for (int c = 0; c < c_counters; ++c)
+        r.dead.n[i][o][c] += n[i][o][c].load(std::memory_order_relaxed);
+  r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+}
+
+inline local_t& local() {
+  static thread_local local_t l;
+  return l;
+}
+
+/// count an op: g_in whether it ran in growth mode, g_out whether it was in growth mode before the
+/// result shrank, sat whether the result was clamped, g_final the mode of the result.
+inline void record(op_t op, bool g_in, bool g_out, bool sat, bool g_final) {
+  auto& l = local();
+  l.add(op, c_ops);
+  if (g_in) l.add(op, c_growth_ops);
+  if (g_out && !g_in) l.add(op, c_grow);
+  if (sat) l.add(op, c_saturate);
+  if (g_out && !g_final) l.add(op, c_shrink);
+}
+
+/// attribute the ops of this thread to a layer until the end of the scope.
+struct scope_t {
+#if defined(QNUM_STATS)
+  int saved;
+  explicit scope_t(const char* layer) : saved(local().layer) { local().layer = registry().layer_id(layer); }
+  ~scope_t() { local().layer = saved; }
+#else
+  explicit scope_t(const char*) {}
+#endif
+};
+
+/// the result of f(), with the ops of f attributed to a layer.
+template<typename F>
+auto in_layer(const char* layer, F f) {
+  scope_t s(layer);
+  return f();
+}
+
+/// print the counts since the previous report, one [QSTATS] line per layer and op.
+inline void report(int epoch, int step) {
+  if constexpr(!enabled) {
+    return;
+  }
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  totals_t now;
+  r.sum(now);
+  for (size_t i = 0; i < r.layers.size(); ++i) {
+    for (int o = 0; o < op_count; ++o) {
+      uint64_t d[c_counters];
+      for (int c = 0; c < c_counters; ++c) d[c] = now.n[i][o][c] - r.last.n[i][o][c];
+      if (d[c_ops] == 0) continue;
+      std::cout << "[QSTATS] epoch= " << std::setw(3) << epoch
+                << " step= "          << std::setw(5) << step
+                << " layer= "         << r.layers[i]
+                << " op= "            << op_name(o)
+                << " ops= "           << d[c_ops]
+                << " growth_ops= "    << d[c_growth_ops]
+                << " grow= "          << d[c_grow]
+                << " saturate= "      << d[c_saturate]
+                << " shrink= "        << d[c_shrink]
+                << '\n';
+    }
+  }
+  std::cout << std::flush;
+  r.last = now;
+}
+
+}
+}
@@ -124,6 +124,22 @@ void q16_eigen_check() {
   debug_dump(W * x);
 }
 
+// accumulate an update below the resolution of T at 1.0: with round to nearest it is lost,
+// with stochastic rounding the sum follows the exact one (1.6103515625) on average.
+template<typename T>
+void stochastic_accum_check() {
+  T acc = 1.0;
+  T a = 0.125;
+  T b = 0.00048828125;
+  double mean_conv = 0.0;
+  for (int i = 0; i < 10000; ++i) {
+    acc += a * b;
+    mean_conv += static_cast<double>(T(0.00013));
+  }
+  debug_dump(acc);
+  debug_dump(mean_conv / 10000);
+}
+
 template<typename T>
 void autodiff_check() {
   int vec_size = 128;
@@ -160,6 +176,7 @@ int main(int argc, char** argv) {
 
   using ff16_5 = flex::float16_t;
   using ff15_5 = flex::flexfloat<5, 9>;
+  using ff16_5s = flex::flexfloat<5, 10, qnum::round_stochastic>;
   run(flex_check<ff16_5>);
   run(flex_check<ff15_5>);
   //run(flex_eigen_check);
@@ -170,6 +187,10 @@ int main(int argc, char** argv) {
   run(growth_mul_check<q16_4>);
   run(growth_add_check<q15_3>);
   run(growth_mul_check<q15_3>);
+  run(stochastic_accum_check<qnum16_t<>>);
+  run(stochastic_accum_check<qnum16s_t<>>);
+  run(stochastic_accum_check<flex::float16_t>);
+  run(stochastic_accum_check<ff16_5s>);
   //run(autodiff_check<qnum64_t<>>);
   //run(autodiff_check<qnum32_t<>>);
   //run(autodiff_check<qnum16_t<>>);
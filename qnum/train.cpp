@@ -10,26 +10,76 @@ template<typename T> void entry(int E, const string& arch, const string& dataset
   const dataset_t<T>* ptest = std::get<1>(dataset_tup);
   nn_t<T>* pnet = init_net<T>(arch, nhidden, ptrain);
 
+  optim_t<T>* poptim = make_optim<T>(option("optim", "sgd"), option("optim-state", "same"));
+
+  checkpoint_info_t resume;
   if(checkpoint != nullptr) {
     cout << "[DEBUG] Loading checkpoint from " << checkpoint << endl;
-    pnet->load(checkpoint);
+    if (!load_checkpoint(checkpoint, *pnet, poptim, &resume)) {
+      return;
+    }
+    cout << "[DEBUG] resuming at epoch " << resume.epoch << " (checkpoint taken at step " << resume.step << ")" << endl;
+  }
+
+  // snapshots are written behind the training loop
+  checkpointer_t checkpointer(std::stoi(option("keep-checkpoints", "0")));
+
+  // --metrics=FILE records the training metrics off the hot loop instead of printing [TRAIN] lines
+  std::unique_ptr<metrics_sink_t> metrics;
+  if (has_option("metrics")) {
+    metrics = std::make_unique<metrics_sink_t>(option("metrics", ""), has_option("metrics-tsv"));
   }
 
+  // parameter histograms every N steps, of the values and with --hist-grad also of the gradients
+  int hist_every = std::stoi(option("hist-every", "10"));
+  bool hist_grad = has_option("hist-grad");
+  histogram_t hist_spec(std::stoi(option("hist-bins", "20")));
+  histogram_t grad_spec(hist_spec.counts.size(), -1.0, 1.0, true);
+
+  // schedule, clipping and step skipping, see engine.hpp
+  int epochs = std::stoi(option("epochs", "20"));
+  long long steps_per_epoch = (ptrain->size + g_batch_size - 1) / g_batch_size;
+  engine_t<T> engine(*pnet, *poptim);
+  engine.schedule.kind = option("lr-schedule", "constant");
+  engine.schedule.base = lr;
+  engine.schedule.warmup = std::stoll(option("warmup", "0"));
+  engine.schedule.step_size = std::max(1LL, std::stoll(option("lr-step", std::to_string(steps_per_epoch))));
+  engine.schedule.gamma = std::stod(option("lr-gamma", "0.1"));
+  engine.schedule.total = epochs * steps_per_epoch;
+  engine.clip_norm = std::stod(option("clip-norm", "0"));
+  engine.max_loss = std::stod(option("max-loss", "10"));
+  engine.step = resume.epoch * steps_per_epoch;
+
   int nupdates = 0;
+  // log the tape of the first sample every N steps
+  int tape_stats_every = std::stoi(option("tape-stats", "0"));
+  // report the saturation and growth counters of all qnum ops every N steps (needs -DQNUM_STATS)
+  int qnum_stats_every = std::stoi(option("qnum-stats", "0"));
+  if (qnum_stats_every > 0 && !qnum::stats::enabled) {
+    cout << "[DEBUG] --qnum-stats ignored, built without QNUM_STATS" << endl;
+  }
 
-  for (int epoch = 0; epoch < 20; ++epoch) {
+  for (int epoch = resume.epoch; epoch < epochs; ++epoch) {
     auto samples = ptrain->shuffle();
     auto batch_size = g_batch_size;
+    autodiff::reverse::TapeStats tape_stats;
     auto run = [&](const VectorXtvar<T> &img, 
                   const VectorXtvar<T> &label, 
                   double& loss_store,
                   int& correct_store,
-                  bool backward) {
+                  bool backward,
+                  bool stats = false) {
+      auto t = std::chrono::steady_clock::now();
       auto label_predict = pnet->forward(img);
-      auto loss = loss_crossent(label, label_predict);
+      auto loss = qnum::stats::in_layer("loss", [&]() { return loss_crossent(label, label_predict); });
+      pnet->us_forward += nn_t<T>::elapsed_us(t);
       loss_store = static_cast<double>(loss.expr->val);
       correct_store = (argmax(label) == argmax(label_predict));
-      if (backward) {
+      if (stats) {
+        tape_stats = autodiff::reverse::tape_stats(loss.expr);
+      }
+      // a step already aborted by another sample, or by this one, skips its backward
+      if (backward && engine.check_loss(loss.expr->val)) {
         pnet->backward(loss);
       }
     };
@@ -42,29 +92,33 @@ template<typename T> void entry(int E, const string& arch, const string& dataset
 
     for (auto i = 0; i < ptrain->size; i += batch_size) {
 
-      pnet->seed();
+      engine.begin_step(batch_size);
 
       if (i % 10000 == 0) {
         char buf[256];
         sprintf(buf, "%s-%s-%s-e%d-h%d-lr%f-epoch-%d-step-%d.dmp", type.data(), arch.data(), dataset.data(), E, nhidden, lr, epoch, i);
-        pnet->save(buf);
+        checkpointer.save(buf, *pnet, poptim, epoch, i);
       }
 
+      bool log_tape = tape_stats_every > 0 && (i/batch_size) % tape_stats_every == 0;
       std::vector<std::thread> threads;
       for(auto j = 0; j < batch_size && i + j < ptrain->size; ++j) {
         threads.emplace_back([&](auto idx){
-          run(ptrain->imgs[smpidx[idx]], ptrain->labels[smpidx[idx]], losses[idx - i], corrects[idx - i], true);
+          run(ptrain->imgs[smpidx[idx]], ptrain->labels[smpidx[idx]], losses[idx - i], corrects[idx - i], true, log_tape && idx == i);
         }, i+j);
       }
       for(auto &t: threads) {
         t.join();
       }
+      if (log_tape) {
+        pnet->tape_report(tape_stats, epoch, i);
+      }
 
       // update & print stats
       auto batch_loss = 0.0;
       for(auto l: losses) { batch_loss += l; }
       batch_loss /= batch_size;
-      if (!std::isnormal(batch_loss) || batch_loss > 10.0) {
+      if (!engine.check_batch(batch_loss)) {
         cout << "[DEBUG] abnormal loss detected. dump and ignore now." << endl;
         cout << "[DEBUG] current batch is: ";
         for(auto j = 0; j < batch_size && i + j < ptrain->size; ++j) {
@@ -77,6 +131,13 @@ template<typename T> void entry(int E, const string& arch, const string& dataset
         continue;
       }
 
+      {
+        qnum::stats::scope_t scope("update");
+        if (!engine.update()) {
+          continue;
+        }
+      }
+
       for(auto c: corrects) { total_correct += c; }
       for(auto l: losses) { total_loss += l; }
 
@@ -85,20 +146,39 @@ template<typename T> void entry(int E, const string& arch, const string& dataset
 
       nupdates += batch_size;
 
-      cout 
-        << "[TRAIN] epoch= "  << setw(3)  << epoch
-        << " step= "          << setw(5)  << i
-        << " batchloss= "     << setw(12) << batch_loss
-        << " avgloss= "       << setw(12) << current_loss
-        << " acc= "           << setw(12) << current_acc
-        << " nupdates= "      << setw(10) << nupdates 
-        << endl;
+      if (metrics) {
+        metrics->train(epoch, i, nupdates, batch_loss, current_loss, current_acc);
+      } else {
+        cout 
+          << "[TRAIN] epoch= "  << setw(3)  << epoch
+          << " step= "          << setw(5)  << i
+          << " batchloss= "     << setw(12) << batch_loss
+          << " avgloss= "       << setw(12) << current_loss
+          << " acc= "           << setw(12) << current_acc
+          << " nupdates= "      << setw(10) << nupdates 
+          << " lr= "            << setw(12) << engine.lr
+          << " gradnorm= "      << setw(12) << engine.grad_norm
+          << '\n';
+      }
 
-      pnet->learn(T(lr));
+      if (qnum_stats_every > 0 && (i/batch_size) % qnum_stats_every == 0) {
+        qnum::stats::report(epoch, i);
+      }
 
-      if ((i/batch_size) % 10 == 0) {
-        pnet->check_histogram();
-        // TODO check saturation, but on all nodes, not just weights
+      if ((i/batch_size) % hist_every == 0) {
+        if (metrics) {
+          metrics->histogram(epoch, i, pnet->histogram(hist_spec));
+          if (hist_grad) {
+            metrics->histogram(epoch, i, pnet->histogram(grad_spec));
+          }
+          auto sat = pnet->saturation();
+          metrics->saturation(epoch, i, std::get<0>(sat), std::get<1>(sat), std::get<2>(sat));
+        } else {
+          pnet->check_histogram(hist_spec);
+          if (hist_grad) {
+            pnet->check_histogram(grad_spec);
+          }
+        }
       }
 
     }
@@ -124,6 +204,9 @@ template<typename T> void entry(int E, const string& arch, const string& dataset
       << " avgloss= " << setw(12) << total_loss / (double)ptest->size
       << " acc= "     << setw(12) << total_correct / (double)ptest->size
       << endl;
+    if (metrics) {
+      metrics->test(epoch, total_loss / (double)ptest->size, total_correct / (double)ptest->size);
+    }
   }
 }
 
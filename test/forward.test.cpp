@@ -8,6 +8,9 @@ using namespace Eigen;
 // autodiff includes
 #include <autodiff/forward.hpp>
 #include <autodiff/forward/eigen.hpp>
+#include <autodiff/forward/parallel.hpp>
+#include <autodiff/forward/sparse.hpp>
+#include <autodiff/forward/taylor.hpp>
 using namespace autodiff;
 using namespace autodiff::forward;
 
@@ -938,4 +941,278 @@ TEST_CASE("Eigen::VectorXdual tests", "[dual]")
             for (auto j = 0; j < 3; ++j)
                 REQUIRE(J(i + 3, j + 4) == approx((i == j) ? y.val : 0.0));
     }
+
+    SECTION("testing vector-mode gradient and jacobian derivatives")
+    {
+        auto f = [](const auto& x)
+        {
+            using Scalar = typename std::decay_t<decltype(x)>::Scalar;
+            Scalar s = 0.0;
+            for(auto i = 0; i < x.size(); ++i)
+                s += sin(x[i]) * exp(x[i] / 3.0) + sqrt(x[i]) * log(x[i]) + tanh(x[i]) / x[i];
+            return s;
+        };
+
+        auto F = [](const auto& x)
+        {
+            std::decay_t<decltype(x)> y(x.size());
+            for(auto i = 0; i < x.size(); ++i)
+                y[i] = x[i] * x[(i + 1) % x.size()] - 2.0 * cos(x[i]) + 1.0 / x[i];
+            return y;
+        };
+
+        // 11 variables: one full chunk of 8 directions plus a partial chunk of 3
+        VectorXdual x(11);
+        VectorXdual8 x8(11);
+        for(auto i = 0; i < 11; ++i)
+        {
+            x[i] = i + 1.0;
+            x8[i] = i + 1.0;
+        }
+
+        const VectorXd g = gradient(f, wrt(x), at(x));
+        const VectorXd g8 = gradient(f, wrt(x8), at(x8));
+
+        for(auto i = 0; i < 11; ++i)
+            REQUIRE( g8[i] == approx(g[i]) );
+
+        const MatrixXd J = jacobian(F, wrt(x), at(x));
+        const MatrixXd J8 = jacobian(F, wrt(x8), at(x8));
+        const MatrixXd J4 = jacobian(F, wrt(x8.tail(5)), at(x8));
+
+        REQUIRE( J8.rows() == 11 );
+        REQUIRE( J8.cols() == 11 );
+        REQUIRE( J4.cols() == 5 );
+
+        for(auto i = 0; i < 11; ++i)
+            for(auto j = 0; j < 11; ++j)
+                REQUIRE( J8(i, j) == approx(J(i, j)) );
+
+        for(auto i = 0; i < 11; ++i)
+            for(auto j = 0; j < 5; ++j)
+                REQUIRE( J4(i, j) == approx(J(i, j + 6)) );
+    }
+
+    SECTION("testing parallel gradient, jacobian and hessian derivatives")
+    {
+        auto f = [](const auto& x, const auto& y)
+        {
+            using Scalar = typename std::decay_t<decltype(x)>::Scalar;
+            Scalar s = y * y;
+            for(auto i = 0; i < x.size(); ++i)
+                s += sin(x[i]) * exp(x[i] / 3.0) * y + x[i] * x[(i + 1) % x.size()];
+            return s;
+        };
+
+        auto F = [](const auto& x)
+        {
+            std::decay_t<decltype(x)> y(x.size());
+            for(auto i = 0; i < x.size(); ++i)
+                y[i] = x[i] * x[(i + 1) % x.size()] - 2.0 * cos(x[i]) + 1.0 / x[i];
+            return y;
+        };
+
+        VectorXdual x(21);
+        VectorXdual8 x8(21);
+        VectorXdual2nd x2(9);
+        dual y = 2.0;
+        dual8 y8 = 2.0;
+        HigherOrderDual<2> y2 = 2.0;
+        for(auto i = 0; i < 21; ++i)
+        {
+            x[i] = 0.1 * i + 1.0;
+            x8[i] = 0.1 * i + 1.0;
+        }
+        for(auto i = 0; i < 9; ++i)
+            x2[i] = 0.1 * i + 1.0;
+
+        const VectorXd g = gradient(f, wrtpack(x, y), at(x, y));
+        const VectorXd gp = parallel::gradient(f, wrtpack(x, y), at(x, y), 4);
+        const VectorXd gp8 = parallel::gradient(f, wrtpack(x8, y8), at(x8, y8), 4);
+
+        for(auto i = 0; i < 22; ++i)
+        {
+            REQUIRE( gp[i] == approx(g[i]) );
+            REQUIRE( gp8[i] == approx(g[i]) );
+        }
+
+        VectorXdual Fp;
+        const MatrixXd J = jacobian(F, wrt(x), at(x));
+        const MatrixXd Jp = parallel::jacobian(F, wrt(x), at(x), Fp, 3);
+        const MatrixXd Jp8 = parallel::jacobian(F, wrt(x8.tail(10)), at(x8), 3);
+
+        REQUIRE( Fp.size() == 21 );
+        for(auto i = 0; i < 21; ++i)
+            for(auto j = 0; j < 21; ++j)
+                REQUIRE( Jp(i, j) == approx(J(i, j)) );
+        for(auto i = 0; i < 21; ++i)
+            for(auto j = 0; j < 10; ++j)
+                REQUIRE( Jp8(i, j) == approx(J(i, j + 11)) );
+
+        HigherOrderDual<2> u;
+        VectorXd gh, ghp;
+        const MatrixXd H = hessian(f, wrtpack(x2, y2), at(x2, y2), u, gh);
+        const MatrixXd Hp = parallel::hessian(f, wrtpack(x2, y2), at(x2, y2), u, ghp, 4);
+
+        for(auto i = 0; i < 10; ++i)
+        {
+            REQUIRE( ghp[i] == approx(gh[i]) );
+            for(auto j = 0; j < 10; ++j)
+                REQUIRE( Hp(i, j) == approx(H(i, j)) );
+        }
+    }
+
+    SECTION("testing sparse jacobian derivatives")
+    {
+        // Tridiagonal system with a coupling between the first and last variables
+        auto F = [](const auto& x)
+        {
+            const auto n = x.size();
+            std::decay_t<decltype(x)> y(n);
+            for(auto i = 0; i < n; ++i)
+            {
+                y[i] = -2.0 * x[i] + exp(x[i]) / x[i];
+                if(i > 0) y[i] += sin(x[i - 1]) * x[i];
+                if(i + 1 < n) y[i] -= pow(x[i + 1], 2) + sqrt(x[i + 1]);
+            }
+            y[n - 1] += x[0] * x[n - 1];
+            return y;
+        };
+
+        const VectorXd x = VectorXd::LinSpaced(30, 1.0, 2.0);
+
+        const SparseMatrix<bool> P = sparse::pattern(F, x);
+        const auto color = sparse::coloring(P);
+
+        REQUIRE( P.nonZeros() == 3 * 30 - 2 + 1 );
+        REQUIRE( *std::max_element(color.begin(), color.end()) + 1 <= 4 );
+
+        VectorXdual xd = x.cast<dual>();
+        const MatrixXd J = jacobian(F, wrt(xd), at(xd));
+        const MatrixXd Js = MatrixXd(sparse::jacobian(F, x));
+        const MatrixXd Js8 = MatrixXd(sparse::jacobian<dual8>(F, x, P));
+
+        for(auto i = 0; i < 30; ++i)
+            for(auto j = 0; j < 30; ++j)
+            {
+                REQUIRE( Js(i, j) == approx(J(i, j)) );
+                REQUIRE( Js8(i, j) == approx(J(i, j)) );
+            }
+    }
+
+    SECTION("testing symmetric, vector-mode and sparse hessian derivatives")
+    {
+        auto f = [](const auto& x, const auto& y)
+        {
+            using Scalar = std::decay_t<decltype(y)>;
+            Scalar s = y * y * x[0];
+            for(auto i = 0; i < x.size(); ++i)
+                s += sin(x[i]) * exp(x[i] / 3.0) * y + x[i] * x[(i + 1) % x.size()];
+            return s;
+        };
+
+        const auto n = 11;
+
+        VectorXdual2nd x(n);
+        VectorXdual2nd8 x8(n);
+        HigherOrderDual<2> y = 2.0;
+        dual2nd8 y8 = 2.0;
+        for(auto i = 0; i < n; ++i)
+        {
+            x[i] = 0.1 * i + 1.0;
+            x8[i] = 0.1 * i + 1.0;
+        }
+
+        // Expected Hessian: d2f/dxi2, the cyclic couplings x_i x_{i+1} and the y couplings
+        MatrixXd Hexpected = MatrixXd::Zero(n + 1, n + 1);
+        for(auto i = 0; i < n; ++i)
+        {
+            const double xi = 0.1 * i + 1.0;
+            const double e = std::exp(xi / 3.0);
+            Hexpected(i, i) = 2.0 * (-std::sin(xi) * e + 2.0 / 3.0 * std::cos(xi) * e + std::sin(xi) * e / 9.0);
+            Hexpected(i, (i + 1) % n) += 1.0;
+            Hexpected((i + 1) % n, i) += 1.0;
+            Hexpected(i, n) = Hexpected(n, i) = std::cos(xi) * e + std::sin(xi) * e / 3.0;
+        }
+        Hexpected(0, n) += 4.0;
+        Hexpected(n, 0) += 4.0;
+        Hexpected(n, n) = 2.0 * x[0].val.val;
+
+        HigherOrderDual<2> u;
+        dual2nd8 u8;
+        VectorXd g, g8;
+
+        const MatrixXd H = hessian(f, wrtpack(x, y), at(x, y), u, g);
+        const MatrixXd H8 = hessian(f, wrtpack(x8, y8), at(x8, y8), u8, g8);
+
+        SparseMatrix<bool> P(n + 1, n + 1);
+        std::vector<Triplet<bool>> triplets;
+        for(auto i = 0; i < n; ++i)
+        {
+            triplets.emplace_back(i, i, true);
+            triplets.emplace_back((i + 1) % n, i, true);
+            triplets.emplace_back(n, i, true);
+        }
+        triplets.emplace_back(n, n, true);
+        P.setFromTriplets(triplets.begin(), triplets.end());
+
+        const MatrixXd Hs = sparse::hessian(f, wrtpack(x8, y8), at(x8, y8), P);
+
+        for(auto i = 0; i <= n; ++i)
+        {
+            REQUIRE( g8[i] == approx(g[i]) );
+            for(auto j = 0; j <= n; ++j)
+            {
+                REQUIRE( H(i, j) == approx(Hexpected(i, j)) );
+                REQUIRE( H8(i, j) == approx(Hexpected(i, j)) );
+                REQUIRE( Hs(i, j) == approx(Hexpected(i, j)) );
+            }
+        }
+    }
+}
+
+TEST_CASE("autodiff::Taylor tests", "[taylor]")
+{
+    SECTION("testing derivatives against higher order duals")
+    {
+        auto f = [](auto x) -> decltype(x)
+        {
+            return exp(sin(x) * 0.5) * log(x + 2.0) / sqrt(x) + pow(x, 3.5) - atan(x) * tanh(x)
+                + erf(x / 2.0) * cosh(x) - asin(x / 3.0) + acos(x / 4.0) * tan(x / 5.0)
+                + abs(x - 5.0) * sinh(x) / (1.0 + x) + pow(2.0, x) + pow(x, x) + 1.0 / x - (3.0 - x) * cos(x);
+        };
+
+        using dual4th = HigherOrderDual<4>;
+
+        dual4th x = 0.7;
+        x.val.val.val.grad = x.val.val.grad.val = x.val.grad.val.val = x.grad.val.val.val = 1.0;
+        const dual4th u = f(x);
+
+        Taylor<4> t = 0.7;
+        const auto d = derivatives(f, wrt(t), at(t));
+
+        REQUIRE( d[0] == approx(val(u)) );
+        REQUIRE( d[1] == approx(val(derivative<1>(u))) );
+        REQUIRE( d[2] == approx(val(derivative<2>(u))) );
+        REQUIRE( d[3] == approx(val(derivative<3>(u))) );
+        REQUIRE( d[4] == approx(val(derivative<4>(u))) );
+    }
+
+    SECTION("testing high order derivatives of elementary functions")
+    {
+        Taylor<5> x = 0.0;
+        x[1] = 1.0;
+
+        REQUIRE( derivative<3>(pow(x, 3)) == approx(6.0) );
+        REQUIRE( derivative<5>(exp(2.0 * x)) == approx(32.0) );
+        REQUIRE( derivative<5>(sin(x)) == approx(1.0) );
+        REQUIRE( derivative<4>(cos(x)) == approx(1.0) );
+
+        Taylor<5> y = 2.0;
+        y[1] = 1.0;
+
+        REQUIRE( derivative<1>(log10(y)) == approx(1.0 / (2.0 * std::log(10.0))) );
+        REQUIRE( derivative<5>(log(y)) == approx(24.0 / 32.0) );
+        REQUIRE( derivative<2>(y * y / y) == approx(0.0) );
+    }
 }
@@ -7,10 +7,12 @@
 // autodiff includes
 #include <autodiff/reverse.hpp>
 #include <autodiff/reverse/eigen.hpp>
+#include <autodiff/reverse/tape.hpp>
 
 using autodiff::derivatives;
 using autodiff::gradient;
 using autodiff::hessian;
+using autodiff::hvp;
 using autodiff::val;
 using autodiff::var;
 using autodiff::wrt;
@@ -397,5 +399,275 @@ TEST_CASE("autodiff::VectorXvar tests", "[VectorXvar]")
                 else
                     CHECK( H(i, j) == Approx(val(g[j] / tan(x[i]))) );
         }
+
+        //--------------------------------------------------------------------------
+        // TESTING HESSIAN-VECTOR PRODUCTS
+        //--------------------------------------------------------------------------
+        VectorXd v(5);
+        v << 1.0, -2.0, 0.5, 3.0, -1.0;
+
+        VectorXd Hv = hvp(y, x, v);
+        VectorXd Hv_expected = H * v;
+        for(auto i = 0; i < x.size(); ++i)
+            CHECK( Hv[i] == approx(Hv_expected[i]) );
+
+        y = exp(x[0] * x[1]) / x[2] + sqrt(x[3]) * log(x[4]) - pow(x[1], x[3]) + atan(x[0] - x[4]);
+        H = hessian(y, x, g);
+        Hv = hvp(y, x, v);
+        Hv_expected = H * v;
+        for(auto i = 0; i < x.size(); ++i) {
+            CHECK( Hv[i] == approx(Hv_expected[i]) );
+            CHECK( x[i].grad() == approx(g[i]) );
+        }
+    }
+
+    SECTION("Testing jacobian")
+    {
+        VectorXvar x(4);
+        x << 0.5, 2.0, 1.5, -1.0;
+
+        var s = sin(x[0]) * x[1]; // shared by several outputs
+        VectorXvar y(5);
+        y << s * s + x[2],
+             exp(s) - x[3] * x[0],
+             s / (x[2] * x[2] + 1.0),
+             x[1] * x[1] * x[1],
+             autodiff::reverse::constant(2.0);
+
+        MatrixXd Jref = MatrixXd::Zero(5, 4);
+        for(auto i = 0; i < 5; ++i)
+            Jref.row(i) = gradient(y[i], x).transpose();
+
+        x[0].seed();
+        MatrixXd J = autodiff::jacobian(y, x);
+        CHECK( J.rows() == 5 );
+        CHECK( J.cols() == 4 );
+        for(auto i = 0; i < 5; ++i)
+            for(auto j = 0; j < 4; ++j)
+                CHECK( J(i, j) == approx(Jref(i, j)) );
+
+        // the derivatives stored in the variables are kept
+        CHECK( x[0].grad() == 0.0 );
+
+        // products with the transposed jacobian, several seeds per sweep
+        MatrixXd V = MatrixXd::Random(5, 11);
+        MatrixXd G = autodiff::vjp(y, x, V);
+        MatrixXd Gref = Jref.transpose() * V;
+        CHECK( G.rows() == 4 );
+        CHECK( G.cols() == 11 );
+        for(auto i = 0; i < 4; ++i)
+            for(auto j = 0; j < 11; ++j)
+                CHECK( G(i, j) == approx(Gref(i, j)) );
+
+        // more rows than seeds per sweep, on several threads
+        VectorXvar z(19);
+        for(auto i = 0; i < z.size(); ++i)
+            z[i] = (i + 1.0) * s * x[i % 4] + cos(x[(i + 1) % 4]);
+
+        MatrixXd Jz = autodiff::jacobian(z, x, 3);
+        for(auto i = 0; i < z.size(); ++i)
+        {
+            VectorXd gz = gradient(z[i], x);
+            for(auto j = 0; j < 4; ++j)
+                CHECK( Jz(i, j) == approx(gz[j]) );
+        }
+    }
+}
+TEST_CASE("autodiff::reverse graph passes", "[var]")
+{
+    using autodiff::reverse::Expr;
+    using autodiff::reverse::constant;
+
+    SECTION("Testing constant folding")
+    {
+        var x = 2.0;
+        var c = constant(3.0);
+        var y = x * (c * c + 1.0) + sin(c);
+
+        std::vector<Expr<double>*> vec;
+        y.expr->topology_sort(vec);
+        autodiff::reverse::fold_constants(vec);
+
+        // only x, x * (...) and the final sum are left to visit
+        CHECK( vec.size() == 3 );
+        CHECK( val(y) == approx(2.0 * 10.0 + std::sin(3.0)) );
+
+        y.expr->grad = 1.0;
+        for(auto it = vec.rbegin(); it != vec.rend(); ++it)
+            (*it)->propagate_step();
+
+        CHECK( x.grad() == approx(10.0) );
+    }
+
+    SECTION("Testing rewrite into aggregated sums and products")
+    {
+        using autodiff::reverse::ExprKind;
+        using autodiff::reverse::SumExpr;
+
+        var a = 1.0, b = 2.0, c = 3.0, d = 4.0;
+        var s = a + b * c * d + (c + d);
+        var y = s * s;
+
+        y.rewrite();
+        auto sum = s.expr->rewrite();
+
+        // both operands of y refer to the same node, rewritten only once
+        REQUIRE( sum != nullptr );
+        CHECK( sum->kind == ExprKind::Sum );
+        CHECK( static_cast<SumExpr<double>*>(sum.get())->elements.size() == 4 );
+        CHECK( sum->val == approx(32.0) );
+        CHECK( grad(y, a) == approx(2 * 32.0) );
+        CHECK( grad(y, b) == approx(2 * 32.0 * 12.0) );
     }
-}
\ No newline at end of file
+
+    SECTION("Testing requires_grad")
+    {
+        using autodiff::reverse::ExprKind;
+
+        var x = 2.0;
+        var c = 3.0;
+        c.requires_grad(false);
+
+        // expressions of operands without gradient are plain values
+        var z = sin(c) * c + 1.0;
+        CHECK( z.expr->kind == ExprKind::Constant );
+        CHECK( !z.requires_grad() );
+        CHECK( val(z) == approx(std::sin(3.0) * 3.0 + 1.0) );
+
+        var y = x * z + c;
+        CHECK( y.requires_grad() );
+        CHECK( grad(y, x) == approx(val(z)) );
+
+        // freezing x after the fact is picked up by the folding pass
+        x.requires_grad(false);
+        std::vector<autodiff::reverse::Expr<double>*> vec;
+        y.expr->topology_sort(vec);
+        autodiff::reverse::fold_constants(vec);
+        CHECK( vec.empty() );
+    }
+
+    SECTION("Testing gradient checkpointing")
+    {
+        var a = 0.5;
+        var b = 2.0;
+
+        auto segment = [](const std::vector<var>& in) {
+            var u = sin(in[0]) * in[1];
+            return std::vector<var>{ u * u, exp(u) + in[0] };
+        };
+
+        auto out = autodiff::reverse::checkpoint(std::vector<var>{ a, b }, segment);
+        auto ref = segment(std::vector<var>{ a, b });
+        var y = out[0] + 3.0 * out[1];
+        var z = ref[0] + 3.0 * ref[1];
+
+        CHECK( val(y) == approx(z) );
+
+        const auto ga = grad(z, a);
+        const auto gb = grad(z, b);
+
+        // recursive propagation recomputes the segment for each output
+        CHECK( grad(y, a) == approx(ga) );
+        CHECK( grad(y, b) == approx(gb) );
+
+        // a topological sweep recomputes it once
+        a.seed();
+        b.seed();
+        std::vector<autodiff::reverse::Expr<double>*> vec;
+        y.expr->topology_sort(vec);
+        y.expr->grad = 1.0;
+        for(auto it = vec.rbegin(); it != vec.rend(); ++it)
+            (*it)->propagate_step();
+
+        CHECK( a.grad() == approx(ga) );
+        CHECK( b.grad() == approx(gb) );
+    }
+
+    SECTION("Testing tape statistics")
+    {
+        var x = 2.0;
+        var c = constant(3.0);
+        var s = sin(x);
+        var y = s * s + c * x;
+
+        const auto stats = autodiff::reverse::tape_stats(y.expr);
+        CHECK( stats.nodes == 6 );
+        CHECK( stats.counts.at("MulExpr") == 2 );
+        CHECK( stats.counts.at("SinExpr") == 1 );
+        CHECK( stats.counts.at("IndependentVariableExpr") == 1 );
+        CHECK( stats.depth == 4 );
+        CHECK( stats.max_fan_in == 2 );
+        CHECK( stats.max_fan_out == 2 );
+        CHECK( stats.bytes >= 6 * sizeof(Expr<double>) );
+    }
+
+    SECTION("Testing single-visit adjoint sweep")
+    {
+        // every step uses the previous one twice, so there are 2^50 paths from y to x
+        var x = 0.5;
+        var y = x;
+        double v = 0.5, d = 1.0;
+        for(auto i = 0; i < 50; ++i) {
+            y = 0.5 * (y + y * y);
+            d *= 0.5 * (1.0 + 2.0 * v);
+            v = 0.5 * (v + v * v);
+        }
+        CHECK( val(y) == approx(v) );
+        CHECK( grad(y, x) == approx(d) );
+
+        // a deep chain of operations
+        var z = x;
+        for(auto i = 0; i < 20000; ++i)
+            z = z + 1e-4 * sin(z);
+        const auto [gz] = derivatives(z, wrt(x));
+        CHECK( gz > 0.0 );
+
+        // intermediate derivatives are left at zero, so the graph can be swept again
+        CHECK( grad(y, x) == approx(d) );
+        CHECK( y.expr->grad == 0.0 );
+    }
+
+    SECTION("Testing statement-level fusion")
+    {
+        VectorXvar x(3);
+        x << 0.5, 2.0, 1.5;
+
+        auto [a, b, c] = autodiff::fuse(x[0], x[1], x[2]);
+        var y = a * b + sin(c) * exp(a / b) - pow(b, c) + 2.0 * sqrt(c);
+        var z = x[0] * x[1] + sin(x[2]) * exp(x[0] / x[1]) - pow(x[1], x[2]) + 2.0 * sqrt(x[2]);
+
+        CHECK( val(y) == approx(val(z)) );
+
+        for(auto i = 0; i < 3; ++i)
+            CHECK( grad(y, x[i]) == approx(grad(z, x[i])) );
+
+        // derivatives as expressions are taken on an ordinary graph rebuilt from the statement
+        auto [ya, yb, yc] = derivativesx(y, wrt(x[0], x[1], x[2]));
+        auto [za, zb, zc] = derivativesx(z, wrt(x[0], x[1], x[2]));
+        CHECK( val(ya) == approx(val(za)) );
+        CHECK( val(yb) == approx(val(zb)) );
+        CHECK( val(yc) == approx(val(zc)) );
+
+        // as are second derivatives
+        VectorXd v(3);
+        v << 1.0, -2.0, 0.5;
+
+        VectorXd Hvy = hvp(y, x, v);
+        VectorXd Hvz = hvp(z, x, v);
+        for(auto i = 0; i < 3; ++i)
+            CHECK( Hvy[i] == approx(Hvz[i]) );
+
+        // the whole statement is a single node on top of the variables
+        std::vector<Expr<double>*> vec;
+        y.expr->topology_sort(vec);
+        CHECK( vec.size() == 4 );
+
+        // a statement over variables without gradient is a plain value
+        var k = 3.0;
+        k.requires_grad(false);
+        auto [u] = autodiff::fuse(k);
+        var w = u * u + 1.0;
+        CHECK( !w.requires_grad() );
+        CHECK( val(w) == approx(10.0) );
+    }
+}